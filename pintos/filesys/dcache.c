@@ -0,0 +1,196 @@
+/* dcache.c: Cache of name lookups, by directory and name.
+ *
+ * An entry maps a name in a directory to the sector of its inode, or
+ * records that the directory has no such name. dir_add() and
+ * dir_remove() invalidate the entries for the names they change, so
+ * the cache never answers differently from the directory itself. */
+
+#include "filesys/dcache.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Number of entries kept; the least recently used go first. */
+#define DCACHE_MAX 512
+
+struct dentry {
+	struct hash_elem elem;      /* In dentries. */
+	struct list_elem lru_elem;  /* In lru, most recently used first. */
+	disk_sector_t parent;       /* Inode sector of the directory. */
+	char name[NAME_MAX + 1];
+	bool negative;              /* NAME does not exist in PARENT. */
+	disk_sector_t sector;       /* Inode sector of NAME, if it exists. */
+};
+
+static struct hash dentries;
+static struct list lru;
+static struct lock dcache_lock;
+
+/* Statistics. */
+static long long hit_cnt, negative_cnt, miss_cnt;
+
+static uint64_t
+dentry_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct dentry *d = hash_entry (e, struct dentry, elem);
+	return hash_string (d->name) ^ hash_int (d->parent);
+}
+
+static bool
+dentry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct dentry *a = hash_entry (a_, struct dentry, elem);
+	const struct dentry *b = hash_entry (b_, struct dentry, elem);
+	if (a->parent != b->parent)
+		return a->parent < b->parent;
+	return strcmp (a->name, b->name) < 0;
+}
+
+/* Initializes the dentry cache. */
+void
+dcache_init (void) {
+	if (!hash_init (&dentries, dentry_hash, dentry_less, NULL))
+		PANIC ("cannot create dentry cache");
+	list_init (&lru);
+	lock_init (&dcache_lock);
+}
+
+/* Returns the entry for NAME in PARENT, or a null pointer.
+ * Called with dcache_lock held. */
+static struct dentry *
+dentry_find (disk_sector_t parent, const char *name) {
+	struct dentry key;
+	struct hash_elem *e;
+
+	key.parent = parent;
+	strlcpy (key.name, name, sizeof key.name);
+	e = hash_find (&dentries, &key.elem);
+	return e != NULL ? hash_entry (e, struct dentry, elem) : NULL;
+}
+
+/* Removes D from the cache and frees it.
+ * Called with dcache_lock held. */
+static void
+dentry_free (struct dentry *d) {
+	hash_delete (&dentries, &d->elem);
+	list_remove (&d->lru_elem);
+	free (d);
+}
+
+/* Looks up NAME in the directory whose inode is in PARENT. On a hit,
+ * stores the sector of its inode into *SECTOR. */
+enum dcache_result
+dcache_lookup (disk_sector_t parent, const char *name,
+		disk_sector_t *sector) {
+	enum dcache_result result = DCACHE_MISS;
+	struct dentry *d;
+
+	if (strlen (name) > NAME_MAX) {
+		miss_cnt++;
+		return DCACHE_MISS;
+	}
+
+	lock_acquire (&dcache_lock);
+	d = dentry_find (parent, name);
+	if (d == NULL)
+		miss_cnt++;
+	else {
+		list_remove (&d->lru_elem);
+		list_push_front (&lru, &d->lru_elem);
+		if (d->negative) {
+			negative_cnt++;
+			result = DCACHE_NEGATIVE;
+		} else {
+			hit_cnt++;
+			*sector = d->sector;
+			result = DCACHE_HIT;
+		}
+	}
+	lock_release (&dcache_lock);
+	return result;
+}
+
+/* Records that NAME in PARENT is the inode in SECTOR, or that it does
+ * not exist if NEGATIVE. */
+static void
+dcache_record (disk_sector_t parent, const char *name, bool negative,
+		disk_sector_t sector) {
+	struct dentry *d;
+
+	if (strlen (name) > NAME_MAX)
+		return;
+
+	lock_acquire (&dcache_lock);
+	d = dentry_find (parent, name);
+	if (d == NULL) {
+		if (hash_size (&dentries) >= DCACHE_MAX)
+			dentry_free (list_entry (list_back (&lru), struct dentry,
+						lru_elem));
+		d = malloc (sizeof *d);
+		if (d == NULL) {
+			lock_release (&dcache_lock);
+			return;
+		}
+		d->parent = parent;
+		strlcpy (d->name, name, sizeof d->name);
+		hash_insert (&dentries, &d->elem);
+	} else
+		list_remove (&d->lru_elem);
+	list_push_front (&lru, &d->lru_elem);
+	d->negative = negative;
+	d->sector = sector;
+	lock_release (&dcache_lock);
+}
+
+/* Records that NAME in PARENT is the inode in SECTOR. */
+void
+dcache_insert (disk_sector_t parent, const char *name, disk_sector_t sector) {
+	dcache_record (parent, name, false, sector);
+}
+
+/* Records that PARENT has no entry named NAME. */
+void
+dcache_insert_negative (disk_sector_t parent, const char *name) {
+	dcache_record (parent, name, true, 0);
+}
+
+/* Forgets what is known about NAME in PARENT. */
+void
+dcache_invalidate (disk_sector_t parent, const char *name) {
+	struct dentry *d;
+
+	if (strlen (name) > NAME_MAX)
+		return;
+
+	lock_acquire (&dcache_lock);
+	d = dentry_find (parent, name);
+	if (d != NULL)
+		dentry_free (d);
+	lock_release (&dcache_lock);
+}
+
+/* Forgets every entry of the directory in PARENT. */
+void
+dcache_invalidate_dir (disk_sector_t parent) {
+	struct list_elem *e;
+
+	lock_acquire (&dcache_lock);
+	for (e = list_begin (&lru); e != list_end (&lru); ) {
+		struct dentry *d = list_entry (e, struct dentry, lru_elem);
+		e = list_next (e);
+		if (d->parent == parent)
+			dentry_free (d);
+	}
+	lock_release (&dcache_lock);
+}
+
+/* Prints dentry cache statistics. */
+void
+dcache_print_stats (void) {
+	printf ("Dentry cache: %lld hits, %lld negative hits, %lld misses\n",
+			hit_cnt, negative_cnt, miss_cnt);
+}
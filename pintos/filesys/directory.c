@@ -1,10 +1,13 @@
 #include "filesys/directory.h"
 #include <stdio.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* A directory. */
 struct dir {
@@ -19,10 +22,48 @@ struct dir_entry {
 	bool in_use;                        /* In use or free? */
 };
 
+/* Directory indexes kept around after their directories are closed. */
+#define DIR_INDEX_MAX 16
+
+/* In-memory index of the entries of a directory by name, built by
+ * reading the directory once and then kept up to date by dir_add()
+ * and dir_remove(). Looking a name up needs no directory I/O. */
+struct dir_index {
+	struct list_elem elem;              /* In dir_indexes. */
+	disk_sector_t sector;               /* Directory inode sector. */
+	struct hash names;                  /* struct dir_name by name. */
+	off_t *free_ofs;                    /* Offsets of unused entries. */
+	size_t free_cnt, free_cap;
+};
+
+/* An entry in use, in a directory index. */
+struct dir_name {
+	struct hash_elem elem;              /* In dir_index's NAMES. */
+	disk_sector_t inode_sector;
+	off_t ofs;                          /* Offset of the entry. */
+	char name[NAME_MAX + 1];
+};
+
+/* Indexes built, most recently used first, and their lock. */
+static struct list dir_indexes;
+static struct lock dir_index_lock;
+
+static void dir_index_drop (disk_sector_t sector);
+
+/* Initializes the directory module. */
+void
+dir_init (void) {
+	list_init (&dir_indexes);
+	lock_init (&dir_index_lock);
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
  * given SECTOR.  Returns true if successful, false on failure. */
 bool
 dir_create (disk_sector_t sector, size_t entry_cnt) {
+	/* SECTOR may have held a directory removed since. */
+	dir_index_drop (sector);
+	dcache_invalidate_dir (sector);
 	return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
 }
 
@@ -71,6 +112,137 @@ dir_get_inode (struct dir *dir) {
 	return dir->inode;
 }
 
+static uint64_t
+dir_name_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_string (hash_entry (e, struct dir_name, elem)->name);
+}
+
+static bool
+dir_name_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return strcmp (hash_entry (a, struct dir_name, elem)->name,
+			hash_entry (b, struct dir_name, elem)->name) < 0;
+}
+
+static void
+dir_name_free (struct hash_elem *e, void *aux UNUSED) {
+	free (hash_entry (e, struct dir_name, elem));
+}
+
+static void
+dir_index_free (struct dir_index *index) {
+	hash_destroy (&index->names, dir_name_free);
+	free (index->free_ofs);
+	free (index);
+}
+
+/* Records that the entry at OFS of INDEX is unused.
+ * Returns false if memory allocation fails. */
+static bool
+dir_index_add_free (struct dir_index *index, off_t ofs) {
+	if (index->free_cnt == index->free_cap) {
+		size_t cap = index->free_cap ? index->free_cap * 2 : 8;
+		off_t *free_ofs = realloc (index->free_ofs, cap * sizeof *free_ofs);
+		if (free_ofs == NULL)
+			return false;
+		index->free_ofs = free_ofs;
+		index->free_cap = cap;
+	}
+	index->free_ofs[index->free_cnt++] = ofs;
+	return true;
+}
+
+/* Records entry E, at OFS, in INDEX.
+ * Returns false if memory allocation fails. */
+static bool
+dir_index_add_name (struct dir_index *index, const struct dir_entry *e,
+		off_t ofs) {
+	struct dir_name *n = malloc (sizeof *n);
+	if (n == NULL)
+		return false;
+	n->inode_sector = e->inode_sector;
+	n->ofs = ofs;
+	strlcpy (n->name, e->name, sizeof n->name);
+	hash_insert (&index->names, &n->elem);
+	return true;
+}
+
+/* Returns the entry named NAME in INDEX, or a null pointer. */
+static struct dir_name *
+dir_index_find (struct dir_index *index, const char *name) {
+	struct dir_name key;
+	struct hash_elem *e;
+
+	if (strlen (name) > NAME_MAX)
+		return NULL;
+	strlcpy (key.name, name, sizeof key.name);
+	e = hash_find (&index->names, &key.elem);
+	return e != NULL ? hash_entry (e, struct dir_name, elem) : NULL;
+}
+
+/* Returns the index of directory INODE, building it if there is none.
+ * Returns a null pointer if memory allocation fails.
+ * Called with dir_index_lock held. */
+static struct dir_index *
+dir_index_get (struct inode *inode) {
+	disk_sector_t sector = inode_get_inumber (inode);
+	struct dir_index *index;
+	struct dir_entry e;
+	struct list_elem *el;
+	off_t ofs;
+
+	ASSERT (lock_held_by_current_thread (&dir_index_lock));
+
+	for (el = list_begin (&dir_indexes); el != list_end (&dir_indexes);
+			el = list_next (el)) {
+		index = list_entry (el, struct dir_index, elem);
+		if (index->sector == sector) {
+			list_remove (el);
+			list_push_front (&dir_indexes, el);
+			return index;
+		}
+	}
+
+	index = calloc (1, sizeof *index);
+	if (index == NULL || !hash_init (&index->names, dir_name_hash,
+				dir_name_less, NULL)) {
+		free (index);
+		return NULL;
+	}
+	index->sector = sector;
+	for (ofs = 0; inode_read_at (inode, &e, sizeof e, ofs) == sizeof e;
+			ofs += sizeof e)
+		if (e.in_use ? !dir_index_add_name (index, &e, ofs)
+				: !dir_index_add_free (index, ofs)) {
+			dir_index_free (index);
+			return NULL;
+		}
+
+	if (list_size (&dir_indexes) >= DIR_INDEX_MAX)
+		dir_index_free (list_entry (list_pop_back (&dir_indexes),
+					struct dir_index, elem));
+	list_push_front (&dir_indexes, &index->elem);
+	return index;
+}
+
+/* Forgets the index of the directory in SECTOR, if any. */
+static void
+dir_index_drop (disk_sector_t sector) {
+	struct list_elem *e;
+
+	lock_acquire (&dir_index_lock);
+	for (e = list_begin (&dir_indexes); e != list_end (&dir_indexes);
+			e = list_next (e)) {
+		struct dir_index *index = list_entry (e, struct dir_index, elem);
+		if (index->sector == sector) {
+			list_remove (e);
+			dir_index_free (index);
+			break;
+		}
+	}
+	lock_release (&dir_index_lock);
+}
+
 /* Searches DIR for a file with the given NAME.
  * If successful, returns true, sets *EP to the directory entry
  * if EP is non-null, and sets *OFSP to the byte offset of the
@@ -79,12 +251,32 @@ dir_get_inode (struct dir *dir) {
 static bool
 lookup (const struct dir *dir, const char *name,
 		struct dir_entry *ep, off_t *ofsp) {
+	struct dir_index *index;
 	struct dir_entry e;
 	size_t ofs;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
+	lock_acquire (&dir_index_lock);
+	index = dir_index_get (dir->inode);
+	if (index != NULL) {
+		struct dir_name *n = dir_index_find (index, name);
+		if (n != NULL) {
+			if (ep != NULL) {
+				ep->inode_sector = n->inode_sector;
+				strlcpy (ep->name, n->name, sizeof ep->name);
+				ep->in_use = true;
+			}
+			if (ofsp != NULL)
+				*ofsp = n->ofs;
+		}
+		lock_release (&dir_index_lock);
+		return n != NULL;
+	}
+	lock_release (&dir_index_lock);
+
+	/* No memory for an index: scan the directory. */
 	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 			ofs += sizeof e)
 		if (e.in_use && !strcmp (name, e.name)) {
@@ -104,15 +296,30 @@ lookup (const struct dir *dir, const char *name,
 bool
 dir_lookup (const struct dir *dir, const char *name,
 		struct inode **inode) {
+	disk_sector_t parent, sector;
 	struct dir_entry e;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
-	if (lookup (dir, name, &e, NULL))
-		*inode = inode_open (e.inode_sector);
-	else
-		*inode = NULL;
+	parent = inode_get_inumber (dir->inode);
+	switch (dcache_lookup (parent, name, &sector)) {
+		case DCACHE_HIT:
+			*inode = inode_open (sector);
+			break;
+		case DCACHE_NEGATIVE:
+			*inode = NULL;
+			break;
+		default:
+			if (lookup (dir, name, &e, NULL)) {
+				dcache_insert (parent, name, e.inode_sector);
+				*inode = inode_open (e.inode_sector);
+			} else {
+				dcache_insert_negative (parent, name);
+				*inode = NULL;
+			}
+			break;
+	}
 
 	return *inode != NULL;
 }
@@ -139,6 +346,30 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 	/* Check that NAME is not in use. */
 	if (lookup (dir, name, NULL, NULL))
 		goto done;
+	dcache_invalidate (inode_get_inumber (dir->inode), name);
+
+	/* Take a free slot from the index if it has one. */
+	lock_acquire (&dir_index_lock);
+	struct dir_index *index = dir_index_get (dir->inode);
+	if (index != NULL) {
+		ofs = index->free_cnt > 0
+			? index->free_ofs[index->free_cnt - 1] : inode_length (dir->inode);
+		e.in_use = true;
+		strlcpy (e.name, name, sizeof e.name);
+		e.inode_sector = inode_sector;
+		success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+		if (success) {
+			if (index->free_cnt > 0 && ofs == index->free_ofs[index->free_cnt - 1])
+				index->free_cnt--;
+			if (!dir_index_add_name (index, &e, ofs)) {
+				list_remove (&index->elem);
+				dir_index_free (index);
+			}
+		}
+		lock_release (&dir_index_lock);
+		goto done;
+	}
+	lock_release (&dir_index_lock);
 
 	/* Set OFS to offset of free slot.
 	 * If there are no free slots, then it will be set to the
@@ -185,10 +416,27 @@ dir_remove (struct dir *dir, const char *name) {
 		goto done;
 
 	/* Erase directory entry. */
+	dcache_invalidate (inode_get_inumber (dir->inode), name);
 	e.in_use = false;
 	if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
 		goto done;
 
+	/* Drop the name from the index, or the whole index if it cannot
+	 * keep track of the free slot. An index built just now already
+	 * lacks the name. */
+	lock_acquire (&dir_index_lock);
+	struct dir_index *index = dir_index_get (dir->inode);
+	struct dir_name *n = index != NULL ? dir_index_find (index, name) : NULL;
+	if (n != NULL) {
+		hash_delete (&index->names, &n->elem);
+		free (n);
+		if (!dir_index_add_free (index, ofs)) {
+			list_remove (&index->elem);
+			dir_index_free (index);
+		}
+	}
+	lock_release (&dir_index_lock);
+
 	/* Remove inode. */
 	inode_remove (inode);
 	success = true;
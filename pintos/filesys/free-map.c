@@ -36,6 +36,65 @@ free_map_allocate (size_t cnt, disk_sector_t *sectorp) {
 	return sector != BITMAP_ERROR;
 }
 
+/* Marks the CNT free sectors starting at SECTOR as used and writes
+ * the free map back. Returns false, leaving them free, if the free
+ * map cannot be written. */
+static bool
+free_map_take (disk_sector_t sector, size_t cnt) {
+	bitmap_set_multiple (free_map, sector, cnt, true);
+	if (free_map_file != NULL && !bitmap_write (free_map, free_map_file)) {
+		bitmap_set_multiple (free_map, sector, cnt, false);
+		return false;
+	}
+	return true;
+}
+
+/* Allocates as many as CNT consecutive sectors starting exactly at
+ * SECTOR, stopping at the first one in use.
+ * Returns the number of sectors allocated, which may be 0. */
+size_t
+free_map_allocate_at (disk_sector_t sector, size_t cnt) {
+	size_t n = 0;
+
+	while (n < cnt && sector + n < bitmap_size (free_map)
+			&& !bitmap_test (free_map, sector + n))
+		n++;
+	if (n > 0 && !free_map_take (sector, n))
+		n = 0;
+	return n;
+}
+
+/* Allocates a run of at most CNT consecutive sectors: the first run of
+ * CNT free sectors, or the longest free run if there is none that
+ * long. Stores the first sector into *SECTORP.
+ * Returns the length of the run, or 0 if the disk is full. */
+size_t
+free_map_allocate_run (size_t cnt, disk_sector_t *sectorp) {
+	size_t size = bitmap_size (free_map);
+	size_t start = bitmap_scan (free_map, 0, cnt, false);
+	size_t len = cnt;
+
+	if (start == BITMAP_ERROR) {
+		size_t i = 0;
+
+		len = 0;
+		while (i < size) {
+			size_t j = i;
+			while (j < size && !bitmap_test (free_map, j))
+				j++;
+			if (j - i > len) {
+				start = i;
+				len = j - i;
+			}
+			i = j + 1;
+		}
+	}
+	if (len == 0 || !free_map_take (start, len))
+		return 0;
+	*sectorp = start;
+	return len;
+}
+
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (disk_sector_t sector, size_t cnt) {
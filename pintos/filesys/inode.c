@@ -5,20 +5,64 @@
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/page_cache.h"
 #include "threads/malloc.h"
+#ifdef EFILESYS
+#include "filesys/fat.h"
+#endif
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* A file growing by writes asks for its data sectors in multiples of
+ * this many, so that files written side by side still end up in long
+ * runs. */
+#define GROW_SECTORS 8
+
+/* A run of consecutive data sectors. It holds the file's sectors from
+ * LOGICAL up to the LOGICAL of the next extent, or up to the inode's
+ * SECTOR_CNT for the last one. */
+struct extent {
+	uint32_t logical;                   /* Index of first sector in file. */
+	disk_sector_t start;                /* Disk sector of it. */
+};
+
+#ifdef EFILESYS
+/* On-disk inode. The data sectors are the clusters of a FAT chain.
+ * Must be exactly DISK_SECTOR_SIZE bytes long. */
+struct inode_disk {
+	cluster_t start;                    /* First data cluster, or 0. */
+	off_t length;                       /* File size in bytes. */
+	unsigned magic;                     /* Magic number. */
+	uint32_t sector_cnt;                /* Data sectors allocated. */
+	uint32_t unused[124];               /* Not used. */
+};
+#else
+/* Extents held in the inode itself, and in each indirect block. */
+#define DIRECT_EXTENTS 60
+#define INDIRECT_EXTENTS 63
+
 /* On-disk inode.
  * Must be exactly DISK_SECTOR_SIZE bytes long. */
 struct inode_disk {
-	disk_sector_t start;                /* First data sector. */
 	off_t length;                       /* File size in bytes. */
 	unsigned magic;                     /* Magic number. */
-	uint32_t unused[125];               /* Not used. */
+	uint32_t sector_cnt;                /* Data sectors allocated. */
+	uint32_t extent_cnt;                /* Extents, direct and indirect. */
+	disk_sector_t indirect;             /* First indirect block, or 0. */
+	uint32_t unused[3];                 /* Not used. */
+	struct extent extents[DIRECT_EXTENTS];
 };
 
+/* Extents past the direct ones, in a chain of blocks.
+ * Must be exactly DISK_SECTOR_SIZE bytes long. */
+struct indirect_block {
+	disk_sector_t next;                 /* Next block, or 0. */
+	uint32_t unused;                    /* Not used. */
+	struct extent extents[INDIRECT_EXTENTS];
+};
+#endif
+
 /* Returns the number of sectors to allocate for an inode SIZE
  * bytes long. */
 static inline size_t
@@ -33,9 +77,76 @@ struct inode {
 	int open_cnt;                       /* Number of openers. */
 	bool removed;                       /* True if deleted, false otherwise. */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+	off_t read_end;                     /* Where the last read stopped. */
+	disk_sector_t readahead;            /* Last sector read ahead. */
 	struct inode_disk data;             /* Inode content. */
+	struct extent *extents;             /* Runs of data sectors, in order. */
+	size_t extent_cnt;
+	size_t extent_cap;                  /* Room in EXTENTS. */
+#ifndef EFILESYS
+	disk_sector_t *blocks;              /* Indirect blocks, in chain order. */
+	size_t block_cnt;
+#endif
 };
 
+/* Returns the number of sectors in extent IDX of INODE. */
+static size_t
+extent_length (const struct inode *inode, size_t idx) {
+	uint32_t end = idx + 1 < inode->extent_cnt
+		? inode->extents[idx + 1].logical : inode->data.sector_cnt;
+	return end - inode->extents[idx].logical;
+}
+
+/* Returns the sector right after INODE's last data sector, which must
+ * exist. */
+static disk_sector_t
+extent_end (const struct inode *inode) {
+	size_t n = inode->extent_cnt;
+	ASSERT (n > 0);
+	return inode->extents[n - 1].start + extent_length (inode, n - 1);
+}
+
+/* Makes room in INODE's extent array for one more extent.
+ * Returns false if memory allocation fails. */
+static bool
+extent_reserve (struct inode *inode) {
+	if (inode->extent_cnt == inode->extent_cap) {
+		size_t cap = inode->extent_cap * 2;
+		struct extent *extents = realloc (inode->extents,
+				cap * sizeof *extents);
+		if (extents == NULL)
+			return false;
+		inode->extents = extents;
+		inode->extent_cap = cap;
+	}
+	return true;
+}
+
+/* Appends the CNT sectors starting at START to the data of INODE,
+ * merging them into the last extent when they follow it on the disk.
+ * Room for a new extent must have been reserved. */
+static void
+extent_push (struct inode *inode, disk_sector_t start, size_t cnt) {
+	size_t n = inode->extent_cnt;
+
+	if (n == 0 || extent_end (inode) != start) {
+		ASSERT (n < inode->extent_cap);
+		inode->extents[n].logical = inode->data.sector_cnt;
+		inode->extents[n].start = start;
+		inode->extent_cnt++;
+	}
+	inode->data.sector_cnt += cnt;
+}
+
+/* Zeroes the CNT sectors starting at START. */
+static void
+zero_sectors (disk_sector_t start, size_t cnt) {
+	static char zeros[DISK_SECTOR_SIZE];
+
+	for (size_t i = 0; i < cnt; i++)
+		page_cache_write (start + i, zeros, 0, DISK_SECTOR_SIZE);
+}
+
 /* Returns the disk sector that contains byte offset POS within
  * INODE.
  * Returns -1 if INODE does not contain data for a byte at offset
@@ -43,11 +154,216 @@ struct inode {
 static disk_sector_t
 byte_to_sector (const struct inode *inode, off_t pos) {
 	ASSERT (inode != NULL);
-	if (pos < inode->data.length)
-		return inode->data.start + pos / DISK_SECTOR_SIZE;
-	else
+	if (pos >= inode->data.length)
 		return -1;
+
+	/* Find the last extent starting at or before the sector. */
+	uint32_t idx = pos / DISK_SECTOR_SIZE;
+	size_t lo = 0, hi = inode->extent_cnt;
+	while (hi - lo > 1) {
+		size_t mid = (lo + hi) / 2;
+		if (inode->extents[mid].logical <= idx)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return inode->extents[lo].start + (idx - inode->extents[lo].logical);
+}
+
+#ifdef EFILESYS
+/* Writes INODE back to the disk. Its chain lives in the FAT, so FIRST
+ * is unused. */
+static void
+inode_write_back (struct inode *inode, size_t first UNUSED) {
+	page_cache_write (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+}
+
+/* Builds INODE's extents by walking its chain once, so that later
+ * lookups need not.
+ * Returns false if memory allocation fails. */
+static bool
+inode_read_extents (struct inode *inode) {
+	inode->data.sector_cnt = 0;
+	for (cluster_t clst = inode->data.start; clst != 0 && clst != EOChain;
+			clst = fat_get (clst)) {
+		if (!extent_reserve (inode))
+			return false;
+		extent_push (inode, cluster_to_sector (clst), SECTORS_PER_CLUSTER);
+	}
+	return true;
+}
+
+/* Extends INODE's chain until it has at least SECTORS data sectors,
+ * asking for up to WANT in all, and zeroes the new ones.
+ * Returns false if the disk fills up or memory allocation fails; the
+ * sectors allocated by then are kept. */
+static bool
+inode_allocate (struct inode *inode, size_t sectors, size_t want) {
+	while (inode->data.sector_cnt < want) {
+		cluster_t last = inode->extent_cnt > 0
+			? sector_to_cluster (extent_end (inode) - 1) : 0;
+		cluster_t clst;
+
+		if (!extent_reserve (inode) || (clst = fat_create_chain (last)) == 0)
+			break;
+		if (last == 0)
+			inode->data.start = clst;
+		extent_push (inode, cluster_to_sector (clst), SECTORS_PER_CLUSTER);
+		zero_sectors (cluster_to_sector (clst), SECTORS_PER_CLUSTER);
+	}
+	inode_write_back (inode, 0);
+	return inode->data.sector_cnt >= sectors;
+}
+
+/* Releases INODE's data clusters. */
+static void
+inode_release_data (struct inode *inode) {
+	if (inode->data.start != 0)
+		fat_remove_chain (inode->data.start, 0);
+	inode->data.start = 0;
+	inode->data.sector_cnt = 0;
+	inode->extent_cnt = 0;
 }
+#else
+/* Writes INODE's extents from extent FIRST on, and the inode itself,
+ * back to the disk. */
+static void
+inode_write_back (struct inode *inode, size_t first) {
+	size_t cnt = inode->extent_cnt;
+	size_t direct = cnt < DIRECT_EXTENTS ? cnt : DIRECT_EXTENTS;
+
+	memcpy (inode->data.extents, inode->extents,
+			direct * sizeof *inode->extents);
+	inode->data.extent_cnt = cnt;
+	inode->data.indirect = inode->block_cnt > 0 ? inode->blocks[0] : 0;
+	page_cache_write (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+
+	for (size_t b = 0; b < inode->block_cnt; b++) {
+		size_t base = DIRECT_EXTENTS + b * INDIRECT_EXTENTS;
+		if (base + INDIRECT_EXTENTS <= first)
+			continue;
+
+		struct indirect_block block;
+		size_t n = cnt - base < INDIRECT_EXTENTS
+			? cnt - base : INDIRECT_EXTENTS;
+		memset (&block, 0, sizeof block);
+		block.next = b + 1 < inode->block_cnt ? inode->blocks[b + 1] : 0;
+		memcpy (block.extents, inode->extents + base,
+				n * sizeof *inode->extents);
+		page_cache_write (inode->blocks[b], &block, 0, DISK_SECTOR_SIZE);
+	}
+}
+
+/* Reads INODE's extents, direct and indirect.
+ * Returns false if memory allocation fails. */
+static bool
+inode_read_extents (struct inode *inode) {
+	size_t cnt = inode->data.extent_cnt;
+	size_t direct = cnt < DIRECT_EXTENTS ? cnt : DIRECT_EXTENTS;
+	disk_sector_t sector = inode->data.indirect;
+
+	if (cnt > inode->extent_cap) {
+		struct extent *extents = realloc (inode->extents,
+				cnt * sizeof *extents);
+		if (extents == NULL)
+			return false;
+		inode->extents = extents;
+		inode->extent_cap = cnt;
+	}
+	memcpy (inode->extents, inode->data.extents,
+			direct * sizeof *inode->extents);
+	for (size_t base = DIRECT_EXTENTS; base < cnt; base += INDIRECT_EXTENTS) {
+		struct indirect_block block;
+		size_t n = cnt - base < INDIRECT_EXTENTS ? cnt - base : INDIRECT_EXTENTS;
+		disk_sector_t *blocks = realloc (inode->blocks,
+				(inode->block_cnt + 1) * sizeof *blocks);
+		if (blocks == NULL)
+			return false;
+		inode->blocks = blocks;
+		blocks[inode->block_cnt++] = sector;
+
+		page_cache_read (sector, &block, 0, DISK_SECTOR_SIZE);
+		memcpy (inode->extents + base, block.extents,
+				n * sizeof *inode->extents);
+		sector = block.next;
+	}
+	inode->extent_cnt = cnt;
+	return true;
+}
+
+/* Makes room for one more extent in INODE, on the disk as well as in
+ * memory, allocating an indirect block when the last one is full.
+ * Returns false if memory or disk allocation fails. */
+static bool
+inode_reserve_extent (struct inode *inode) {
+	size_t n = inode->extent_cnt;
+
+	if (!extent_reserve (inode))
+		return false;
+	if (n >= DIRECT_EXTENTS + inode->block_cnt * INDIRECT_EXTENTS) {
+		disk_sector_t *blocks = realloc (inode->blocks,
+				(inode->block_cnt + 1) * sizeof *blocks);
+		if (blocks == NULL)
+			return false;
+		inode->blocks = blocks;
+		if (!free_map_allocate (1, &blocks[inode->block_cnt]))
+			return false;
+		inode->block_cnt++;
+	}
+	return true;
+}
+
+/* Allocates data sectors for INODE until it has at least SECTORS,
+ * asking for up to WANT in all, and zeroes them. Sectors right after
+ * the last extent are taken first, then the longest runs available.
+ * Writes the new extents back.
+ * Returns false if the disk fills up or memory allocation fails; the
+ * sectors allocated by then are kept. */
+static bool
+inode_allocate (struct inode *inode, size_t sectors, size_t want) {
+	size_t first = inode->extent_cnt > 0 ? inode->extent_cnt - 1 : 0;
+	bool success = true;
+
+	if (inode->data.sector_cnt >= sectors)
+		return true;
+
+	while (inode->data.sector_cnt < sectors) {
+		size_t left = want - inode->data.sector_cnt;
+		disk_sector_t start = 0;
+		size_t cnt = 0;
+
+		if (inode->extent_cnt > 0) {
+			start = extent_end (inode);
+			cnt = free_map_allocate_at (start, left);
+		}
+		if (cnt == 0) {
+			cnt = free_map_allocate_run (left, &start);
+			if (cnt == 0 || !inode_reserve_extent (inode)) {
+				if (cnt > 0)
+					free_map_release (start, cnt);
+				success = false;
+				break;
+			}
+		}
+		extent_push (inode, start, cnt);
+		zero_sectors (start, cnt);
+	}
+	inode_write_back (inode, first);
+	return success;
+}
+
+/* Releases INODE's data sectors and indirect blocks. */
+static void
+inode_release_data (struct inode *inode) {
+	for (size_t i = 0; i < inode->extent_cnt; i++)
+		free_map_release (inode->extents[i].start, extent_length (inode, i));
+	for (size_t i = 0; i < inode->block_cnt; i++)
+		free_map_release (inode->blocks[i], 1);
+	inode->data.sector_cnt = 0;
+	inode->extent_cnt = 0;
+	inode->block_cnt = 0;
+}
+#endif
 
 /* List of open inodes, so that opening a single inode twice
  * returns the same `struct inode'. */
@@ -67,31 +383,34 @@ inode_init (void) {
 bool
 inode_create (disk_sector_t sector, off_t length) {
 	struct inode_disk *disk_inode = NULL;
+	struct inode *inode;
 	bool success = false;
 
 	ASSERT (length >= 0);
 
-	/* If this assertion fails, the inode structure is not exactly
+	/* If these assertions fail, the inode structures are not exactly
 	 * one sector in size, and you should fix that. */
 	ASSERT (sizeof *disk_inode == DISK_SECTOR_SIZE);
+#ifndef EFILESYS
+	ASSERT (sizeof (struct indirect_block) == DISK_SECTOR_SIZE);
+#endif
 
 	disk_inode = calloc (1, sizeof *disk_inode);
 	if (disk_inode != NULL) {
-		size_t sectors = bytes_to_sectors (length);
-		disk_inode->length = length;
 		disk_inode->magic = INODE_MAGIC;
-		if (free_map_allocate (sectors, &disk_inode->start)) {
-			disk_write (filesys_disk, sector, disk_inode);
-			if (sectors > 0) {
-				static char zeros[DISK_SECTOR_SIZE];
-				size_t i;
-
-				for (i = 0; i < sectors; i++) 
-					disk_write (filesys_disk, disk_inode->start + i, zeros); 
-			}
-			success = true; 
-		} 
+		page_cache_write (sector, disk_inode, 0, DISK_SECTOR_SIZE);
 		free (disk_inode);
+
+		inode = inode_open (sector);
+		if (inode != NULL) {
+			size_t sectors = bytes_to_sectors (length);
+			success = inode_allocate (inode, sectors, sectors);
+			if (!success)
+				inode_release_data (inode);
+			inode->data.length = success ? length : 0;
+			inode_write_back (inode, inode->extent_cnt);
+			inode_close (inode);
+		}
 	}
 	return success;
 }
@@ -120,12 +439,29 @@ inode_open (disk_sector_t sector) {
 		return NULL;
 
 	/* Initialize. */
-	list_push_front (&open_inodes, &inode->elem);
 	inode->sector = sector;
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
-	disk_read (filesys_disk, inode->sector, &inode->data);
+	inode->read_end = 0;
+	inode->readahead = -1;
+	page_cache_read (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+	inode->extent_cnt = 0;
+	inode->extent_cap = 16;
+	inode->extents = malloc (inode->extent_cap * sizeof *inode->extents);
+#ifndef EFILESYS
+	inode->blocks = NULL;
+	inode->block_cnt = 0;
+#endif
+	if (inode->extents == NULL || !inode_read_extents (inode)) {
+#ifndef EFILESYS
+		free (inode->blocks);
+#endif
+		free (inode->extents);
+		free (inode);
+		return NULL;
+	}
+	list_push_front (&open_inodes, &inode->elem);
 	return inode;
 }
 
@@ -159,11 +495,18 @@ inode_close (struct inode *inode) {
 
 		/* Deallocate blocks if removed. */
 		if (inode->removed) {
+#ifdef EFILESYS
+			fat_remove_chain (sector_to_cluster (inode->sector), 0);
+#else
 			free_map_release (inode->sector, 1);
-			free_map_release (inode->data.start,
-					bytes_to_sectors (inode->data.length)); 
+#endif
+			inode_release_data (inode);
 		}
 
+#ifndef EFILESYS
+		free (inode->blocks);
+#endif
+		free (inode->extents);
 		free (inode); 
 	}
 }
@@ -183,7 +526,7 @@ off_t
 inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 	uint8_t *buffer = buffer_;
 	off_t bytes_read = 0;
-	uint8_t *bounce = NULL;
+	bool sequential = offset == inode->read_end;
 
 	while (size > 0) {
 		/* Disk sector to read, starting byte offset within sector. */
@@ -200,46 +543,62 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 		if (chunk_size <= 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Read full sector directly into caller's buffer. */
-			disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
-		} else {
-			/* Read sector into bounce buffer, then partially copy
-			 * into caller's buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-			disk_read (filesys_disk, sector_idx, bounce);
-			memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-		}
+		page_cache_read (sector_idx, buffer + bytes_read, sector_ofs,
+				chunk_size);
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_read += chunk_size;
 	}
-	free (bounce);
+
+	/* A reader going on from where the last read stopped will likely
+	 * want the sector after the one it stopped in next, so start
+	 * reading it now, unless that is past the end of file. */
+	if (sequential && bytes_read > 0) {
+		off_t next = ROUND_DOWN (offset - 1, DISK_SECTOR_SIZE)
+			+ DISK_SECTOR_SIZE;
+		disk_sector_t sector_idx = next < inode_length (inode)
+			? byte_to_sector (inode, next) : (disk_sector_t) -1;
+		if (sector_idx != (disk_sector_t) -1
+				&& sector_idx != inode->readahead) {
+			page_cache_prefetch (sector_idx);
+			inode->readahead = sector_idx;
+		}
+	}
+	inode->read_end = offset;
 
 	return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
  * Returns the number of bytes actually written, which may be
- * less than SIZE if end of file is reached or an error occurs.
- * (Normally a write at end of file would extend the inode, but
- * growth is not yet implemented.) */
+ * less than SIZE if the disk fills up or an error occurs.
+ * Writing past the end of file extends it; the gap, if any, reads
+ * as zeros. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		off_t offset) {
 	const uint8_t *buffer = buffer_;
 	off_t bytes_written = 0;
-	uint8_t *bounce = NULL;
 
 	if (inode->deny_write_cnt)
 		return 0;
 
+	if (offset + size > inode->data.length) {
+		size_t sectors = bytes_to_sectors (offset + size);
+		off_t end;
+
+		inode_allocate (inode, sectors, ROUND_UP (sectors, GROW_SECTORS));
+		end = (off_t) inode->data.sector_cnt * DISK_SECTOR_SIZE;
+		if (end > offset + size)
+			end = offset + size;
+		if (end > inode->data.length) {
+			inode->data.length = end;
+			inode_write_back (inode, inode->extent_cnt);
+		}
+	}
+
 	while (size > 0) {
 		/* Sector to write, starting byte offset within sector. */
 		disk_sector_t sector_idx = byte_to_sector (inode, offset);
@@ -255,34 +614,16 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		if (chunk_size <= 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Write full sector directly to disk. */
-			disk_write (filesys_disk, sector_idx, buffer + bytes_written); 
-		} else {
-			/* We need a bounce buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-
-			/* If the sector contains data before or after the chunk
-			   we're writing, then we need to read in the sector
-			   first.  Otherwise we start with a sector of all zeros. */
-			if (sector_ofs > 0 || chunk_size < sector_left) 
-				disk_read (filesys_disk, sector_idx, bounce);
-			else
-				memset (bounce, 0, DISK_SECTOR_SIZE);
-			memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-			disk_write (filesys_disk, sector_idx, bounce); 
-		}
+		/* The cache reads the sector in first unless the chunk covers
+		 * all of it. */
+		page_cache_write (sector_idx, buffer + bytes_written, sector_ofs,
+				chunk_size);
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_written += chunk_size;
 	}
-	free (bounce);
 
 	return bytes_written;
 }
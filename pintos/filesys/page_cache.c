@@ -1,6 +1,21 @@
-/* page_cache.c: Implementation of Page Cache (Buffer Cache). */
+/* page_cache.c: Implementation of Page Cache (Buffer Cache).
+ *
+ * Every sector the file system reads or writes goes through a fixed
+ * set of cached sectors. Writes only dirty the cached copy; a worker
+ * daemon writes dirty sectors back once they have aged, and whatever
+ * is left is written when the file system shuts down. A second daemon
+ * reads ahead the sectors sequential readers are about to ask for. */
 
+#include "filesys/page_cache.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
 #include "vm/vm.h"
+
 static bool page_cache_readahead (struct page *page, void *kva);
 static bool page_cache_writeback (struct page *page);
 static void page_cache_destroy (struct page *page);
@@ -13,38 +28,296 @@ static const struct page_operations page_cache_op = {
 	.type = VM_PAGE_CACHE,
 };
 
+/* Number of cached sectors. */
+#define CACHE_SIZE 64
+
+/* How often the worker daemon looks for dirty sectors, and how long a
+ * sector may stay dirty before it writes it back. */
+#define WRITEBACK_INTERVAL (TIMER_FREQ)
+#define WRITEBACK_AGE (5 * TIMER_FREQ)
+
+/* Read-ahead requests not yet served; later ones are dropped. */
+#define READAHEAD_MAX 16
+
+/* A cached sector. While BUSY, the sector is being read in or written
+ * back without cache_lock held, and nobody else may touch DATA. */
+struct cache_entry {
+	disk_sector_t sector;       /* Sector held, if VALID or BUSY. */
+	bool valid;                 /* DATA holds SECTOR's contents. */
+	bool busy;                  /* Disk I/O in progress. */
+	bool dirty;                 /* Written since last written back. */
+	bool accessed;              /* Used since the clock hand passed. */
+	int64_t dirty_since;        /* Tick it became dirty. */
+	uint8_t data[DISK_SECTOR_SIZE];
+};
+
+static struct cache_entry cache[CACHE_SIZE];
+static size_t clock_hand;
+
+/* Protects the cache entries and the read-ahead queue. */
+static struct lock cache_lock;
+/* Signaled when an entry stops being busy. */
+static struct condition cache_io;
+
+/* Sectors waiting to be read ahead, as a ring. */
+static disk_sector_t readahead_queue[READAHEAD_MAX];
+static size_t readahead_head, readahead_len;
+static struct semaphore readahead_sema;
+
+/* Statistics. */
+static long long hit_cnt, miss_cnt, readahead_cnt, writeback_cnt;
+
 tid_t page_cache_workerd;
+static bool page_cache_started;
 
-/* The initializer of file vm */
+static void page_cache_kworkerd (void *aux);
+static void page_cache_readaheadd (void *aux);
+
+/* Initializes the page cache and starts its daemons. Called from both
+ * filesys_init() and vm_init(); only the first call does anything. */
 void
 pagecache_init (void) {
-	/* TODO: Create a worker daemon for page cache with page_cache_kworkerd */
+	if (page_cache_started)
+		return;
+	page_cache_started = true;
+
+	lock_init (&cache_lock);
+	cond_init (&cache_io);
+	sema_init (&readahead_sema, 0);
+
+	page_cache_workerd = thread_create ("kworkerd", PRI_DEFAULT,
+			page_cache_kworkerd, NULL);
+	if (page_cache_workerd == TID_ERROR
+			|| thread_create ("readahead", PRI_DEFAULT,
+				page_cache_readaheadd, NULL) == TID_ERROR)
+		PANIC ("cannot start page cache daemons");
 }
 
 /* Initialize the page cache */
 bool
-page_cache_initializer (struct page *page, enum vm_type type, void *kva) {
+page_cache_initializer (struct page *page, enum vm_type type UNUSED,
+		void *kva UNUSED) {
 	/* Set up the handler */
 	page->operations = &page_cache_op;
-
+	return true;
 }
 
-/* Utilze the Swap in mechanism to implement readhead */
+/* The cache holds disk sectors rather than user pages, so no page is
+ * ever given page_cache_op and the handlers below have nothing to do.
+ * Read-ahead and write-back are done by the daemons further down. */
 static bool
-page_cache_readahead (struct page *page, void *kva) {
+page_cache_readahead (struct page *page UNUSED, void *kva UNUSED) {
+	return false;
 }
 
-/* Utilze the Swap out mechanism to implement writeback */
 static bool
-page_cache_writeback (struct page *page) {
+page_cache_writeback (struct page *page UNUSED) {
+	return false;
 }
 
 /* Destory the page_cache. */
 static void
-page_cache_destroy (struct page *page) {
+page_cache_destroy (struct page *page UNUSED) {
+}
+
+/* Returns the entry holding SECTOR, or NULL. */
+static struct cache_entry *
+cache_find_locked (disk_sector_t sector) {
+	for (size_t i = 0; i < CACHE_SIZE; i++) {
+		struct cache_entry *e = &cache[i];
+		if ((e->valid || e->busy) && e->sector == sector)
+			return e;
+	}
+	return NULL;
+}
+
+/* Picks an entry to reuse with the clock algorithm, preferring unused
+ * entries. Returns NULL if every entry is busy. */
+static struct cache_entry *
+cache_victim_locked (void) {
+	for (size_t i = 0; i < 2 * CACHE_SIZE; i++) {
+		struct cache_entry *e = &cache[clock_hand];
+		clock_hand = (clock_hand + 1) % CACHE_SIZE;
+
+		if (e->busy)
+			continue;
+		if (!e->valid)
+			return e;
+		if (e->accessed)
+			e->accessed = false;
+		else
+			return e;
+	}
+	return NULL;
+}
+
+/* Writes dirty entry E back to the disk. Releases cache_lock for the
+ * duration of the write. */
+static void
+cache_writeback (struct cache_entry *e) {
+	ASSERT (lock_held_by_current_thread (&cache_lock));
+	ASSERT (e->valid && e->dirty && !e->busy);
+
+	e->busy = true;
+	e->dirty = false;
+	lock_release (&cache_lock);
+	disk_write (filesys_disk, e->sector, e->data);
+	lock_acquire (&cache_lock);
+	e->busy = false;
+	writeback_cnt++;
+	cond_broadcast (&cache_io, &cache_lock);
+}
+
+/* Returns the entry holding SECTOR, reading it in first if it is not
+ * cached. If LOAD is false, the caller is about to overwrite the whole
+ * sector and a newly assigned entry is left unread. Only DEMAND lookups
+ * count as hits or misses; read-ahead does not. May release cache_lock
+ * while waiting on the disk. */
+static struct cache_entry *
+cache_get_locked (disk_sector_t sector, bool load, bool demand) {
+	ASSERT (lock_held_by_current_thread (&cache_lock));
+
+	for (;;) {
+		struct cache_entry *e = cache_find_locked (sector);
+		if (e != NULL) {
+			if (e->busy) {
+				cond_wait (&cache_io, &cache_lock);
+				continue;
+			}
+			if (demand)
+				hit_cnt++;
+			e->accessed = true;
+			return e;
+		}
+
+		e = cache_victim_locked ();
+		if (e == NULL) {
+			cond_wait (&cache_io, &cache_lock);
+			continue;
+		}
+		if (e->dirty) {
+			/* The lock was dropped, so look again from scratch. */
+			cache_writeback (e);
+			continue;
+		}
+
+		if (demand)
+			miss_cnt++;
+		e->sector = sector;
+		e->valid = false;
+		e->accessed = true;
+		if (load) {
+			e->busy = true;
+			lock_release (&cache_lock);
+			disk_read (filesys_disk, sector, e->data);
+			lock_acquire (&cache_lock);
+			e->busy = false;
+			cond_broadcast (&cache_io, &cache_lock);
+		}
+		e->valid = true;
+		return e;
+	}
+}
+
+/* Reads SIZE bytes at offset OFS within SECTOR into BUFFER. */
+void
+page_cache_read (disk_sector_t sector, void *buffer, off_t ofs, size_t size) {
+	ASSERT (ofs >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+	lock_acquire (&cache_lock);
+	struct cache_entry *e = cache_get_locked (sector, true, true);
+	memcpy (buffer, e->data + ofs, size);
+	lock_release (&cache_lock);
+}
+
+/* Writes SIZE bytes from BUFFER at offset OFS within SECTOR. The write
+ * reaches the disk later. */
+void
+page_cache_write (disk_sector_t sector, const void *buffer, off_t ofs,
+		size_t size) {
+	ASSERT (ofs >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+	lock_acquire (&cache_lock);
+	struct cache_entry *e = cache_get_locked (sector,
+			size < DISK_SECTOR_SIZE, true);
+	memcpy (e->data + ofs, buffer, size);
+	if (!e->dirty) {
+		e->dirty = true;
+		e->dirty_since = timer_ticks ();
+	}
+	lock_release (&cache_lock);
+}
+
+/* Asks for SECTOR to be read into the cache in the background. */
+void
+page_cache_prefetch (disk_sector_t sector) {
+	lock_acquire (&cache_lock);
+	if (readahead_len < READAHEAD_MAX && cache_find_locked (sector) == NULL) {
+		readahead_queue[(readahead_head + readahead_len) % READAHEAD_MAX]
+			= sector;
+		readahead_len++;
+		sema_up (&readahead_sema);
+	}
+	lock_release (&cache_lock);
+}
+
+/* Writes every dirty sector back to the disk. */
+void
+page_cache_flush (void) {
+	lock_acquire (&cache_lock);
+	for (size_t i = 0; i < CACHE_SIZE; i++) {
+		struct cache_entry *e = &cache[i];
+		while (e->busy)
+			cond_wait (&cache_io, &cache_lock);
+		if (e->valid && e->dirty)
+			cache_writeback (e);
+	}
+	lock_release (&cache_lock);
+}
+
+/* Prints page cache statistics. */
+void
+page_cache_print_stats (void) {
+	long long lookups = hit_cnt + miss_cnt;
+	printf ("Cache: %lld hits, %lld misses (%lld%% hit rate), "
+			"%lld read ahead, %lld written back\n",
+			hit_cnt, miss_cnt, lookups ? hit_cnt * 100 / lookups : 0,
+			readahead_cnt, writeback_cnt);
+}
+
+/* Worker thread for page cache: writes back sectors that have been
+ * dirty for a while, so a crash loses little and eviction rarely has
+ * to wait on a write. */
+static void
+page_cache_kworkerd (void *aux UNUSED) {
+	for (;;) {
+		timer_sleep (WRITEBACK_INTERVAL);
+
+		lock_acquire (&cache_lock);
+		for (size_t i = 0; i < CACHE_SIZE; i++) {
+			struct cache_entry *e = &cache[i];
+			if (e->valid && e->dirty && !e->busy
+					&& timer_elapsed (e->dirty_since) >= WRITEBACK_AGE)
+				cache_writeback (e);
+		}
+		lock_release (&cache_lock);
+	}
 }
 
-/* Worker thread for page cache */
+/* Reads in the sectors queued by page_cache_prefetch(). */
 static void
-page_cache_kworkerd (void *aux) {
+page_cache_readaheadd (void *aux UNUSED) {
+	for (;;) {
+		sema_down (&readahead_sema);
+
+		lock_acquire (&cache_lock);
+		disk_sector_t sector = readahead_queue[readahead_head];
+		readahead_head = (readahead_head + 1) % READAHEAD_MAX;
+		readahead_len--;
+		if (cache_find_locked (sector) == NULL) {
+			cache_get_locked (sector, true, false);
+			readahead_cnt++;
+		}
+		lock_release (&cache_lock);
+	}
 }
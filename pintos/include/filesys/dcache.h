@@ -0,0 +1,23 @@
+#ifndef FILESYS_DCACHE_H
+#define FILESYS_DCACHE_H
+
+#include "devices/disk.h"
+
+/* Outcome of a dentry cache lookup. */
+enum dcache_result {
+	DCACHE_MISS,                /* Not cached; ask the directory. */
+	DCACHE_HIT,                 /* Name exists, at the sector returned. */
+	DCACHE_NEGATIVE,            /* Name known not to exist. */
+};
+
+void dcache_init (void);
+enum dcache_result dcache_lookup (disk_sector_t parent, const char *name,
+		disk_sector_t *sector);
+void dcache_insert (disk_sector_t parent, const char *name,
+		disk_sector_t sector);
+void dcache_insert_negative (disk_sector_t parent, const char *name);
+void dcache_invalidate (disk_sector_t parent, const char *name);
+void dcache_invalidate_dir (disk_sector_t parent);
+void dcache_print_stats (void);
+
+#endif /* filesys/dcache.h */
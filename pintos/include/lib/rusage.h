@@ -0,0 +1,14 @@
+#ifndef __LIB_RUSAGE_H
+#define __LIB_RUSAGE_H
+
+/* Paging statistics of a process, as returned by getrusage(). */
+struct rusage {
+	long long faults;           /* Page faults handled. */
+	long long lazy_loads;       /* Pages loaded on first access. */
+	long long swap_ins;         /* Anonymous pages brought back after eviction. */
+	long long file_reads;       /* File pages read again after eviction. */
+	long long evictions;        /* Pages evicted. */
+	long long stack_growths;    /* Stack pages added. */
+};
+
+#endif /* lib/rusage.h */
@@ -36,6 +36,12 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Extra for Project 3 */
+	SYS_MADVISE,                /* Give advice about use of memory. */
+	SYS_MSYNC,                  /* Write a memory mapping back to its file. */
+	SYS_GETRUSAGE,              /* Obtain paging statistics. */
+	SYS_SETRSSLIMIT,            /* Cap resident memory. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <debug.h>
 #include <stddef.h>
+#include <rusage.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -13,6 +14,29 @@ typedef int pid_t;
 typedef int off_t;
 #define MAP_FAILED ((void *) NULL)
 
+/* Flags or'd into the WRITABLE argument of mmap(). */
+#define MAP_POPULATE 0x100      /* Load the whole mapping up front. */
+#define MAP_SHARED 0x200        /* Share anonymous memory with children. */
+
+/* FD of mmap() for memory that is not backed by a file. */
+#define MAP_ANONYMOUS (-1)
+
+/* Advice for madvise(). */
+#define MADV_NORMAL 0           /* No special treatment. */
+#define MADV_RANDOM 1           /* Expect random access. */
+#define MADV_SEQUENTIAL 2       /* Expect sequential access. */
+#define MADV_WILLNEED 3         /* Will need these pages soon. */
+#define MADV_DONTNEED 4         /* Done with these pages. */
+
+/* Flags for msync(). */
+#define MS_ASYNC 1              /* Start writing back, don't wait. */
+#define MS_SYNC 4               /* Write back and wait for it. */
+
+/* Smallest resident set limit setrsslimit() accepts: the faulting
+ * page, the stack and code it runs on and the buffer of a system call
+ * must all fit at once. A limit of 0 means no limit. */
+#define RSS_LIMIT_MIN 8
+
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
@@ -41,6 +65,10 @@ int dup2(int oldfd, int newfd);
 /* Project 3 and optionally project 4. */
 void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap (void *addr);
+int madvise (void *addr, size_t length, int advice);
+int msync (void *addr, size_t length, int flags);
+int getrusage (struct rusage *usage);
+int setrsslimit (size_t pages);
 
 /* Project 4 only. */
 bool chdir (const char *dir);
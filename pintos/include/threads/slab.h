@@ -0,0 +1,23 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <list.h>
+#include <stddef.h>
+#include "threads/synch.h"
+
+/* A cache of equally sized objects of one type. */
+struct slab_cache {
+	const char *name;           /* For debugging. */
+	size_t obj_size;            /* Size of each object in bytes. */
+	size_t objs_per_slab;       /* Number of objects in a slab. */
+	struct list slabs;          /* Slabs with free objects. */
+	size_t slab_cnt;            /* Slabs allocated. */
+	size_t empty_cnt;           /* Slabs in SLABS with no object in use. */
+	struct lock lock;           /* Lock. */
+};
+
+void slab_cache_init (struct slab_cache *, const char *name, size_t size);
+void *slab_alloc (struct slab_cache *) __attribute__ ((malloc));
+void slab_free (void *);
+
+#endif /* threads/slab.h */
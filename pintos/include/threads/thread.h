@@ -9,6 +9,7 @@
 #include "threads/fixed-point.h"
 #include "threads/interrupt.h"
 #ifdef VM
+#include <rusage.h>
 #include "vm/vm.h"
 #endif
 
@@ -121,7 +122,9 @@ struct thread {
 #ifdef VM
     /* Table for whole virtual memory owned by thread. */
     struct supplemental_page_table spt;
-    struct list mmap_list;
+    struct rusage rusage; /* Paging statistics. */
+    size_t rss;           /* Frames its pages map. */
+    size_t rss_limit;     /* Cap on RSS in frames, 0 for none. */
 #endif
 
     /* Owned by thread.c. */
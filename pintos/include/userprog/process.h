@@ -14,11 +14,7 @@ void process_activate (struct thread *next);
 
 #ifdef VM
 
-typedef struct lazy_load_info {
-	struct file *file;
-	off_t ofs;
-	size_t page_read_bytes;
-	size_t page_zero_bytes;
-} lazy_load_info;
+struct page;
+bool lazy_load_segment (struct page *page, void *aux);
 
 #endif
\ No newline at end of file
@@ -5,11 +5,26 @@
 struct page;
 enum vm_type;
 
+struct zswap_entry;
+
+/* Swap slots read back per anonymous page fault, at most. */
+#define SWAP_CLUSTER 8
+
+/* The saved contents of a swapped out page, a swap slot or a
+ * compressed copy, are shared by the copies fork makes of it. */
 struct anon_page {
-	size_t swap_idx;
+	size_t swap_idx;                /* Swap slot, or BITMAP_ERROR. */
+	struct zswap_entry *zswap;      /* Compressed copy, or NULL. */
+	struct list_elem zswap_elem;    /* In ZSWAP's list of pages. */
 };
 
 void vm_anon_init (void);
+void vm_anon_print_stats (void);
+void *do_mmap_anon (void *addr, size_t length, bool writable, bool shared);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
+size_t anon_swap_slot (struct page *page);
+void anon_swap_read (size_t slot, size_t cnt, void *buf);
+void anon_swap_release (struct page *page);
+void anon_swap_share (struct page *src, struct page *dst);
 
 #endif
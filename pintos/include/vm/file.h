@@ -4,29 +4,24 @@
 #include "filesys/file.h"
 
 struct page;
+struct vma;
 enum vm_type;
-struct mmap_file;
 
 struct file_page {
     struct file *file;
     off_t ofs;
     size_t read_bytes;
     size_t zero_bytes;
-    struct mmap_file *mmap;   
-};
-
-struct mmap_file {
-    void *start;
-    size_t page_cnt;
-    struct file *file;
-    off_t offset;
-    struct list_elem elem;
+    bool writeback_pending;     /* Queued by msync(MS_ASYNC). */
 };
 
 
 void vm_file_init (void);
 bool file_backed_initializer (struct page *page, enum vm_type type, void *kva);
 bool lazy_load_file (struct page *page, void *aux);
+bool file_backed_clean (struct page *page);
 void *do_mmap(void *addr, size_t length, int writable, struct file *file, off_t offset);
 void do_munmap (void *va);
+bool do_msync (void *addr, void *end, bool async);
+bool do_msync_area (struct vma *vma);
 #endif
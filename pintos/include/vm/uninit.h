@@ -21,4 +21,7 @@ struct uninit_page {
 void uninit_new (struct page *page, void *va, vm_initializer *init,
 		enum vm_type type, void *aux,
 		bool (*initializer)(struct page *, enum vm_type, void *kva));
+void uninit_reset (struct page *page, vm_initializer *init,
+		enum vm_type type, void *aux,
+		bool (*initializer)(struct page *, enum vm_type, void *kva));
 #endif
@@ -2,6 +2,7 @@
 #define VM_VM_H
 #include <stdbool.h>
 #include "threads/palloc.h"
+#include "threads/slab.h"
 #include "lib/kernel/hash.h"
 #include "filesys/off_t.h"
 
@@ -36,9 +37,26 @@ enum vm_type {
 struct page_operations;
 struct thread;
 struct file;
+struct vma;
 
 #define VM_TYPE(type) ((type) & 7)
 
+/* Marks read-only ELF segment pages, whose frames are shared by every
+ * process running the same binary. */
+#define VM_TEXT VM_MARKER_1
+
+/* Upper bound for the fault-around window. */
+#define FAULT_AROUND_MAX 32
+extern size_t vm_fault_around;
+extern size_t vm_reclaim_low;
+extern size_t vm_reclaim_high;
+extern bool vm_print_rusage;
+
+/* Object caches for per-page metadata. */
+extern struct slab_cache page_slab;         /* struct page. */
+extern struct slab_cache segment_cache;     /* struct segment. */
+extern struct slab_cache file_aux_cache;    /* struct file_page aux. */
+
 /* The representation of "page".
  * This is kind of "parent class", which has four "child class"es, which are
  * uninit_page, file_page, anon_page, and page cache (project4).
@@ -51,6 +69,10 @@ struct page {
 	/* Your implementation */
 	struct hash_elem hash_elem; 
 	bool writable;
+	struct thread *owner;  /* Process whose page table maps VA. */
+	struct vma *vma;       /* Area VA belongs to, if any. */
+	struct list_elem vma_elem;
+	struct list_elem rmap_elem; /* In frame's rmap while FRAME is set. */
          
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -64,10 +86,21 @@ struct page {
 	};
 };
 
-/* The representation of "frame" */
+/* The representation of "frame".
+ * One entry per physical frame of the user pool, preallocated in the
+ * frame table and indexed by frame number. RMAP, the reverse map,
+ * lists every page whose page table maps the frame, so that the frame
+ * can be unmapped from all address spaces at once. REF_CNT counts
+ * those pages plus any other holder, such as a shared area, and is 0
+ * while the frame is free. */
 struct frame {
 	void *kva;
-	struct page *page;
+	struct list rmap;      /* Mapping pages, by their rmap_elem. */
+	unsigned ref_cnt;      /* References, mappings included. */
+	unsigned pin_cnt;      /* Skipped by the clock while nonzero. */
+	struct text_entry *text;  /* Shared text cache entry, if any. */
+	bool huge;             /* Part of a 2 MiB page; never evicted alone. */
+	bool busy;             /* Being evicted or cleaned without frame_lock. */
 };
 
 /* The function table for page operations.
@@ -90,7 +123,9 @@ struct page_operations {
  * We don't want to force you to obey any specific design for this struct.
  * All designs up to you for this. */
 struct supplemental_page_table {
-	struct hash hash_table;
+	struct hash hash_table;   /* Pages touched so far, by VA. */
+	struct vma *vma_root;     /* Tree of memory areas. */
+	struct list prefetches;   /* Pages read ahead by MADV_WILLNEED. */
 };
 
 #include "threads/thread.h"
@@ -101,6 +136,8 @@ void supplemental_page_table_kill (struct supplemental_page_table *spt);
 struct page *spt_find_page (struct supplemental_page_table *spt,
 		void *va);
 bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
+bool vm_page_is_dirty (struct page *page);
+void vm_page_clear_dirty (struct page *page);
 bool spt_remove_page (struct supplemental_page_table *spt, struct page *page);
 
 void vm_init (void);
@@ -113,6 +150,16 @@ bool vm_alloc_page_with_initializer (enum vm_type type, void *upage,
 		bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page (struct page *page);
 bool vm_claim_page (void *va);
+struct frame *vm_pin_page (struct page *page, bool claim);
+void vm_unpin_frame (struct frame *frame);
+struct frame *vm_frame_detach (struct page *page);
+void vm_frame_free (struct frame *frame, struct page *page);
+void vm_frame_put (struct frame *frame);
+void vm_zero_unmap (struct page *page);
+void vm_prefetch (void *start, void *end);
+void vm_willneed (void *start, void *end);
+void vm_huge_unmark (void *kva);
+void vm_discard (void *start, void *end);
 enum vm_type page_get_type (struct page *page);
 
 #endif  /* VM_VM_H */
@@ -0,0 +1,89 @@
+#ifndef VM_VMA_H
+#define VM_VMA_H
+#include <list.h>
+#include "threads/synch.h"
+#include "vm/vm.h"
+
+struct file;
+
+/* Access pattern of an area, as announced with madvise(). */
+enum vma_advice {
+	VMA_NORMAL,
+	VMA_RANDOM,                 /* No fault-around. */
+	VMA_SEQUENTIAL,             /* Widest fault-around, pages used once. */
+};
+
+/* The pages of a MAP_SHARED anonymous mapping, shared by every
+ * process that inherited the mapping. The object holds a reference to
+ * each frame, so the frames stay resident until it goes away; all of
+ * them together may take up at most half of the user pool. */
+struct shmem {
+	struct lock lock;           /* Serializes first touches. */
+	int ref_cnt;                /* Areas using it. */
+	size_t page_cnt;
+	struct frame *frames[];     /* Per page, NULL until first touched. */
+};
+
+/* How to load the pages of an area backed by an executable segment.
+ * Shared by the area, the copies fork makes of it and every one of
+ * their pages not yet loaded, and released with the last of them. */
+struct segment {
+	struct file *file;          /* Owned. */
+	off_t ofs;                  /* File offset of START. */
+	void *start;                /* First page of the area. */
+	size_t read_bytes;          /* Bytes read from FILE; the rest is zero. */
+	struct lock lock;           /* Protects REF_CNT. */
+	int ref_cnt;
+};
+
+/* A virtual memory area: the pages [START, END) of one address space,
+ * sharing the same backing and protection. Pages of an area get their
+ * struct page only when first touched, built from this description.
+ * The areas of an address space never overlap and are kept in an AVL
+ * tree ordered by START. */
+struct vma {
+	void *start;                /* First page. */
+	void *end;                  /* One past the last page. */
+	enum vm_type type;          /* Type of its pages, markers included. */
+	bool writable;
+	struct file *file;          /* Backing file, or NULL. Owned. */
+	off_t ofs;                  /* File offset of START. */
+	size_t read_bytes;          /* Bytes read from FILE; the rest is zero. */
+	enum vma_advice advice;
+	bool mapped;                /* Created by mmap(). */
+	struct shmem *shm;          /* Shared pages, or NULL. */
+	struct segment *seg;        /* Loader of file-backed anonymous pages. */
+	struct list pages;          /* Pages materialized so far. */
+
+	struct vma *left, *right;   /* AVL tree links. */
+	int height;
+};
+
+struct vma *vma_create (struct supplemental_page_table *spt, void *start,
+		void *end, enum vm_type type, bool writable, struct file *file,
+		off_t ofs, size_t read_bytes);
+struct vma *vma_find (struct supplemental_page_table *spt, const void *va);
+bool vma_overlaps (struct supplemental_page_table *spt, const void *start,
+		const void *end);
+bool vma_covers (struct supplemental_page_table *spt, const void *start,
+		const void *end);
+void vma_advise (struct supplemental_page_table *spt, const void *start,
+		const void *end, enum vma_advice advice);
+bool vma_extend_down (struct supplemental_page_table *spt, struct vma *vma,
+		void *start);
+bool vma_share (struct vma *vma);
+bool vma_shared_init (struct page *page, void *aux);
+struct page *vma_materialize (struct vma *vma, void *va);
+void vma_unload (struct vma *vma, struct page *page);
+void vma_destroy (struct supplemental_page_table *spt, struct vma *vma);
+bool vma_copy_all (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src);
+void vma_sync_all (struct supplemental_page_table *spt);
+void vma_destroy_all (struct supplemental_page_table *spt);
+
+struct segment *segment_get (struct segment *seg);
+void segment_put (struct segment *seg);
+void segment_locate (const struct segment *seg, const void *va, off_t *ofs,
+		size_t *read_bytes);
+
+#endif /* vm/vma.h */
@@ -0,0 +1,28 @@
+/* Looks up a file that does not exist, then creates it and checks
+   that it can be opened, and removes it and checks that it cannot:
+   cached lookup results must not outlive the entries they describe. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  const char *file_name = "late";
+  int fd;
+
+  CHECK (open (file_name) == -1, "open \"%s\" before creating it", file_name);
+  CHECK (create (file_name, 123), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (filesize (fd) == 123, "filesize \"%s\"", file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  CHECK (remove (file_name), "remove \"%s\"", file_name);
+  CHECK (open (file_name) == -1, "open \"%s\" after removing it", file_name);
+  CHECK (create (file_name, 45), "create \"%s\" again", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (filesize (fd) == 45, "filesize \"%s\"", file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+}
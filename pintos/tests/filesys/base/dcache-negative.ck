@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dcache-negative) begin
+(dcache-negative) open "late" before creating it
+(dcache-negative) create "late"
+(dcache-negative) open "late"
+(dcache-negative) filesize "late"
+(dcache-negative) close "late"
+(dcache-negative) remove "late"
+(dcache-negative) open "late" after removing it
+(dcache-negative) create "late" again
+(dcache-negative) open "late"
+(dcache-negative) filesize "late"
+(dcache-negative) close "late"
+(dcache-negative) end
+EOF
+pass;
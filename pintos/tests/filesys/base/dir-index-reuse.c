@@ -0,0 +1,77 @@
+/* Fills the root directory, removes every other file and adds new
+   files in their place, then checks that lookups find exactly the
+   files that should be there. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 20
+
+static void
+check_open (const char *name, bool exists) 
+{
+  int fd = open (name);
+
+  if (exists && fd < 2)
+    fail ("open \"%s\" failed", name);
+  if (!exists && fd != -1)
+    fail ("open \"%s\" succeeded after its removal", name);
+  if (fd >= 2)
+    close (fd);
+}
+
+void
+test_main (void) 
+{
+  char name[16];
+  int i;
+
+  msg ("create %d files", FILE_CNT);
+  for (i = 0; i < FILE_CNT; i++) 
+    {
+      snprintf (name, sizeof name, "f%d", i);
+      if (!create (name, i))
+        fail ("create \"%s\" failed", name);
+    }
+
+  msg ("remove every other file");
+  for (i = 1; i < FILE_CNT; i += 2) 
+    {
+      snprintf (name, sizeof name, "f%d", i);
+      if (!remove (name))
+        fail ("remove \"%s\" failed", name);
+    }
+
+  msg ("create files in their place");
+  for (i = 1; i < FILE_CNT; i += 2) 
+    {
+      snprintf (name, sizeof name, "g%d", i);
+      if (!create (name, i))
+        fail ("create \"%s\" failed", name);
+      if (create (name, i))
+        fail ("create \"%s\" succeeded twice", name);
+    }
+
+  msg ("look up every file");
+  for (i = 0; i < FILE_CNT; i++) 
+    {
+      snprintf (name, sizeof name, "f%d", i);
+      check_open (name, i % 2 == 0);
+      snprintf (name, sizeof name, "g%d", i);
+      check_open (name, i % 2 == 1);
+    }
+
+  msg ("check file sizes");
+  for (i = 0; i < FILE_CNT; i++) 
+    {
+      int fd;
+
+      snprintf (name, sizeof name, "%c%d", i % 2 ? 'g' : 'f', i);
+      fd = open (name);
+      if (filesize (fd) != i)
+        fail ("\"%s\" is %d bytes long, not %d", name, filesize (fd), i);
+      close (fd);
+    }
+}
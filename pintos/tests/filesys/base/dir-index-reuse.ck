@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-index-reuse) begin
+(dir-index-reuse) create 20 files
+(dir-index-reuse) remove every other file
+(dir-index-reuse) create files in their place
+(dir-index-reuse) look up every file
+(dir-index-reuse) check file sizes
+(dir-index-reuse) end
+EOF
+pass;
@@ -0,0 +1,58 @@
+/* Grows two files in parallel, a page at a time, so that neither
+   file's sectors are contiguous and each needs more extents than
+   fit in its inode, and checks that their contents are correct. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHUNK_SIZE 4096
+#define CHUNK_CNT 72
+#define FILE_SIZE (CHUNK_SIZE * CHUNK_CNT)
+static char buf_a[FILE_SIZE];
+static char buf_b[FILE_SIZE];
+
+static void
+write_chunk (const char *file_name, int fd, const char *buf, size_t ofs) 
+{
+  size_t ret_val = write (fd, buf + ofs, CHUNK_SIZE);
+  if (ret_val != CHUNK_SIZE)
+    fail ("write %d bytes at offset %zu in \"%s\" returned %zu",
+          CHUNK_SIZE, ofs, file_name, ret_val);
+}
+
+void
+test_main (void) 
+{
+  int fd_a, fd_b;
+  size_t i;
+
+  for (i = 0; i < CHUNK_CNT; i++)
+    {
+      memset (buf_a + i * CHUNK_SIZE, 'a' + i % 26, CHUNK_SIZE);
+      memset (buf_b + i * CHUNK_SIZE, 'A' + i % 26, CHUNK_SIZE);
+    }
+
+  CHECK (create ("a", 0), "create \"a\"");
+  CHECK (create ("b", 0), "create \"b\"");
+
+  CHECK ((fd_a = open ("a")) > 1, "open \"a\"");
+  CHECK ((fd_b = open ("b")) > 1, "open \"b\"");
+
+  msg ("write \"a\" and \"b\" alternately");
+  for (i = 0; i < CHUNK_CNT; i++)
+    {
+      write_chunk ("a", fd_a, buf_a, i * CHUNK_SIZE);
+      write_chunk ("b", fd_b, buf_b, i * CHUNK_SIZE);
+    }
+
+  msg ("close \"a\"");
+  close (fd_a);
+
+  msg ("close \"b\"");
+  close (fd_b);
+
+  check_file ("a", buf_a, FILE_SIZE);
+  check_file ("b", buf_b, FILE_SIZE);
+}
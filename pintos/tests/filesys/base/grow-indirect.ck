@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-indirect) begin
+(grow-indirect) create "a"
+(grow-indirect) create "b"
+(grow-indirect) open "a"
+(grow-indirect) open "b"
+(grow-indirect) write "a" and "b" alternately
+(grow-indirect) close "a"
+(grow-indirect) close "b"
+(grow-indirect) open "a" for verification
+(grow-indirect) verified contents of "a"
+(grow-indirect) close "a"
+(grow-indirect) open "b" for verification
+(grow-indirect) verified contents of "b"
+(grow-indirect) close "b"
+(grow-indirect) end
+EOF
+pass;
@@ -0,0 +1,45 @@
+/* Creates, fills and removes a file over and over, writing more data
+   in all than the disk holds, and checks that the space of removed
+   files is reused. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHUNK_SIZE (64 * 1024)
+#define CHUNK_CNT 16
+#define ROUNDS 12
+static char buf[CHUNK_SIZE];
+
+void
+test_main (void) 
+{
+  const char *file_name = "reuse";
+  int round, i;
+
+  msg ("create, write and remove \"%s\" %d times", file_name, ROUNDS);
+  for (round = 0; round < ROUNDS; round++)
+    {
+      int fd, ret_val;
+
+      memset (buf, 'a' + round, sizeof buf);
+      if (!create (file_name, 0))
+        fail ("create \"%s\" failed in round %d", file_name, round);
+      if ((fd = open (file_name)) < 2)
+        fail ("open \"%s\" failed in round %d", file_name, round);
+      for (i = 0; i < CHUNK_CNT; i++)
+        {
+          ret_val = write (fd, buf, sizeof buf);
+          if (ret_val != (int) sizeof buf)
+            fail ("write \"%s\" returned %d in round %d",
+                  file_name, ret_val, round);
+        }
+      if (filesize (fd) != CHUNK_SIZE * CHUNK_CNT)
+        fail ("\"%s\" is %d bytes long in round %d",
+              file_name, filesize (fd), round);
+      close (fd);
+      if (!remove (file_name))
+        fail ("remove \"%s\" failed in round %d", file_name, round);
+    }
+}
@@ -0,0 +1,39 @@
+/* Reads a file that is not cached yet sequentially, a few bytes at
+   a time, and checks that each of its sectors is read from the disk
+   only once, whether by the reader or by read-ahead. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#define CHUNK_SIZE 100
+
+static const char file_name[] = "tar";
+static char buf[CHUNK_SIZE];
+
+void
+test_main (void) {
+  int fd, size, ofs;
+  long long read_cnt;
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  size = filesize (fd);
+
+  read_cnt = get_fs_disk_read_cnt ();
+
+  msg ("read \"%s\" sequentially", file_name);
+  for (ofs = 0; ofs < size; ofs += CHUNK_SIZE) {
+    int want = size - ofs < CHUNK_SIZE ? size - ofs : CHUNK_SIZE;
+    if (read (fd, buf, CHUNK_SIZE) != want)
+      fail ("read %d bytes at offset %d in \"%s\" failed",
+            want, ofs, file_name);
+    if (ofs == 0 && (buf[0] != 0x7f || buf[1] != 'E'
+                     || buf[2] != 'L' || buf[3] != 'F'))
+      fail ("\"%s\" does not start with an ELF header", file_name);
+  }
+
+  CHECK (get_fs_disk_read_cnt () <= read_cnt + (size + 511) / 512,
+        "check read_cnt");
+
+  msg ("close \"%s\"", file_name);
+  close (fd);
+}
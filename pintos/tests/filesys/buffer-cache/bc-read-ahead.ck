@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(bc-read-ahead) begin
+(bc-read-ahead) open "tar"
+(bc-read-ahead) read "tar" sequentially
+(bc-read-ahead) check read_cnt
+(bc-read-ahead) close "tar"
+(bc-read-ahead) end
+EOF
+pass;
@@ -0,0 +1,40 @@
+/* Rewrites a file many times over and checks that the writes reach
+   the disk only once per sector, since the cache holds dirty sectors
+   until they are written back later. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#define TEST_SIZE 4096
+#define ROUNDS 16
+
+static const char file_name[] = "data";
+static char buf[TEST_SIZE];
+
+void
+test_main (void) {
+  int fd;
+  long long write_cnt;
+
+  CHECK (create (file_name, sizeof buf), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  random_bytes (buf, sizeof buf);
+
+  write_cnt = get_fs_disk_write_cnt ();
+
+  msg ("write \"%s\" %d times", file_name, ROUNDS);
+  for (int i = 0; i < ROUNDS; i++) {
+    buf[i] = i;
+    seek (fd, 0);
+    if (write (fd, buf, sizeof buf) != sizeof buf)
+      fail ("write \"%s\" failed in round %d", file_name, i);
+  }
+
+  CHECK (get_fs_disk_write_cnt () <= write_cnt + TEST_SIZE / 512,
+        "check write_cnt");
+
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, sizeof buf);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(bc-write-behind) begin
+(bc-write-behind) create "data"
+(bc-write-behind) open "data"
+(bc-write-behind) write "data" 16 times
+(bc-write-behind) check write_cnt
+(bc-write-behind) close "data"
+(bc-write-behind) open "data" for verification
+(bc-write-behind) verified contents of "data"
+(bc-write-behind) close "data"
+(bc-write-behind) end
+EOF
+pass;
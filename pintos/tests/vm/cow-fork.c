@@ -0,0 +1,68 @@
+/* Forks children that share the parent's pages copy-on-write. Each
+   child writes one page, which gets a frame of its own while the
+   other pages stay shared. Once the children are gone, the parent
+   writes its pages in place without copying them. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 4
+#define CHILD_CNT 2
+
+static char data[PAGE_CNT][4096];
+static void *pa[PAGE_CNT];
+
+static void
+check_shared (int except)
+{
+  int i;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    if (i != except && get_phys_addr (data[i]) != pa[i])
+      fail ("page %d is not shared with the parent", i);
+}
+
+void
+test_main (void)
+{
+  int child, i;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      memset (data[i], 'a' + i, sizeof data[i]);
+      pa[i] = get_phys_addr (data[i]);
+    }
+
+  for (child = 0; child < CHILD_CNT; child++)
+    {
+      pid_t pid = fork ("child");
+
+      if (pid == 0)
+        {
+          check_shared (-1);
+          msg ("child %d shares every page", child);
+          data[child][0] = 'x';
+          CHECK (get_phys_addr (data[child]) != pa[child],
+                 "child %d got a copy of page %d", child, child);
+          if (data[child][1] != 'a' + child)
+            fail ("copy of page %d is corrupted", child);
+          check_shared (child);
+          msg ("child %d still shares the other pages", child);
+          exit (0);
+        }
+      CHECK (wait (pid) == 0, "wait for child %d", child);
+    }
+
+  for (i = 0; i < PAGE_CNT; i++)
+    if (data[i][0] != 'a' + i)
+      fail ("parent's page %d was changed by a child", i);
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      data[i][0] = 'p';
+      if (get_phys_addr (data[i]) != pa[i])
+        fail ("parent's page %d was copied although nobody shares it", i);
+    }
+  msg ("parent kept its frames");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(cow-fork) begin
+(cow-fork) child 0 shares every page
+(cow-fork) child 0 got a copy of page 0
+(cow-fork) child 0 still shares the other pages
+(cow-fork) wait for child 0
+(cow-fork) child 1 shares every page
+(cow-fork) child 1 got a copy of page 1
+(cow-fork) child 1 still shares the other pages
+(cow-fork) wait for child 1
+(cow-fork) parent kept its frames
+(cow-fork) end
+EOF
+pass;
@@ -0,0 +1,36 @@
+/* Reads every page of a file mapping in order and checks with
+   getrusage() that fault-around loaded them in batches instead of
+   taking one fault per page. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 32
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  struct rusage before, after;
+  long long faults;
+  int handle;
+  size_t i;
+
+  CHECK ((handle = open ("large.txt")) > 1, "open \"large.txt\"");
+  CHECK (mmap (actual, PAGE_CNT * 4096, 0, handle, 0) != MAP_FAILED,
+         "mmap \"large.txt\"");
+  CHECK (getrusage (&before) == 0, "getrusage");
+  for (i = 0; i < PAGE_CNT; i++)
+    if (actual[i * 4096] == '\0')
+      fail ("page %zu of the mapping reads a null byte", i);
+  CHECK (getrusage (&after) == 0, "getrusage");
+
+  faults = after.faults - before.faults;
+  if (faults == 0)
+    fail ("no faults accounted");
+  if (faults >= PAGE_CNT / 2)
+    fail ("%lld faults for %d pages", faults, PAGE_CNT);
+  munmap (actual);
+  close (handle);
+}
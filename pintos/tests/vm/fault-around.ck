@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fault-around) begin
+(fault-around) open "large.txt"
+(fault-around) mmap "large.txt"
+(fault-around) getrusage
+(fault-around) getrusage
+(fault-around) end
+EOF
+pass;
@@ -0,0 +1,37 @@
+/* Touches fresh pages of an anonymous mapping and of the stack and
+   checks that getrusage() accounts for the faults. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static void
+grow_stack (void)
+{
+  volatile char buf[16384];
+
+  memset ((char *) buf, 0, sizeof buf);
+}
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  struct rusage before, after;
+
+  CHECK (mmap (actual, 4096, 1, MAP_ANONYMOUS, 0) != MAP_FAILED,
+         "mmap anonymous");
+  CHECK (getrusage (&before) == 0, "getrusage");
+  actual[0] = 'x';
+  grow_stack ();
+  CHECK (getrusage (&after) == 0, "getrusage");
+
+  if (after.faults <= before.faults)
+    fail ("no faults accounted");
+  if (after.lazy_loads <= before.lazy_loads)
+    fail ("no lazy loads accounted");
+  if (after.stack_growths <= before.stack_growths)
+    fail ("no stack growth accounted");
+  munmap (actual);
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(getrusage) begin
+(getrusage) mmap anonymous
+(getrusage) getrusage
+(getrusage) getrusage
+(getrusage) end
+EOF
+pass;
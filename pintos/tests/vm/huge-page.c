@@ -0,0 +1,75 @@
+/* Touches one byte of a 2 MB aligned anonymous mapping, which backs
+   the whole 2 MB block with a huge page: every page of the block is
+   then mapped, to physically contiguous frames, without being
+   touched. Looking the pages up must not split the huge page. A
+   forked child shares the frames until it writes one page, which
+   gets a copy of its own. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define HUGE_SIZE (2 * 1024 * 1024)
+#define PAGE_CNT (HUGE_SIZE / 4096)
+
+static char *block = (char *) 0x40000000;
+
+/* Checks that the pages of BLOCK map contiguous frames starting at
+   BASE, except for page EXCEPT. */
+static void
+check_contiguous (char *base, int except)
+{
+  int i;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    if (i != except && (char *) get_phys_addr (block + i * 4096) != base + i * 4096)
+      fail ("page %d is not part of the huge page", i);
+}
+
+void
+test_main (void)
+{
+  char *base;
+  pid_t pid;
+  int i;
+
+  CHECK (mmap (block, HUGE_SIZE, 1, MAP_ANONYMOUS, 0) != MAP_FAILED,
+         "mmap 2 MB anonymous");
+  block[0] = 1;
+
+  base = get_phys_addr (block);
+  if ((unsigned long) base % HUGE_SIZE != 0)
+    fail ("block is not backed by an aligned huge page");
+  check_contiguous (base, -1);
+  msg ("one write mapped %d contiguous pages", PAGE_CNT);
+
+  for (i = 0; i < PAGE_CNT; i++)
+    if (block[i * 4096] != (i == 0))
+      fail ("page %d is not zeroed", i);
+  for (i = 0; i < PAGE_CNT; i++)
+    block[i * 4096] = i % 128;
+  check_contiguous (base, -1);
+  msg ("huge page survived reads and writes");
+
+  pid = fork ("child");
+  if (pid == 0)
+    {
+      check_contiguous (base, -1);
+      block[5 * 4096] = 'x';
+      CHECK (get_phys_addr (block + 5 * 4096) != base + 5 * 4096,
+             "child got a copy of page 5");
+      check_contiguous (base, 5);
+      for (i = 0; i < PAGE_CNT; i++)
+        if (i != 5 && block[i * 4096] != i % 128)
+          fail ("child's page %d is corrupted", i);
+      exit (0);
+    }
+  CHECK (wait (pid) == 0, "wait for child");
+
+  for (i = 0; i < PAGE_CNT; i++)
+    if (block[i * 4096] != i % 128)
+      fail ("parent's page %d was changed by the child", i);
+  check_contiguous (base, -1);
+  msg ("parent kept its frames");
+  munmap (block);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(huge-page) begin
+(huge-page) mmap 2 MB anonymous
+(huge-page) one write mapped 512 contiguous pages
+(huge-page) huge page survived reads and writes
+(huge-page) child got a copy of page 5
+(huge-page) wait for child
+(huge-page) parent kept its frames
+(huge-page) end
+EOF
+pass;
@@ -0,0 +1,53 @@
+/* Forks before any page of a multi-page data segment or a large BSS
+   has been loaded, so that both processes load them through the
+   segment's shared loader descriptor, and checks what each sees. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define DATA_PAGES 8
+#define BSS_PAGES 256
+#define WORDS 1024
+
+/* One non-zero word at the start of each page puts the whole array
+   in the data segment. */
+static int data[DATA_PAGES * WORDS] = {
+  [0 * WORDS] = 1, [1 * WORDS] = 2, [2 * WORDS] = 3, [3 * WORDS] = 4,
+  [4 * WORDS] = 5, [5 * WORDS] = 6, [6 * WORDS] = 7, [7 * WORDS] = 8,
+};
+static int bss[BSS_PAGES * WORDS];
+
+static void
+check_segments (const char *who, int tag)
+{
+  size_t i;
+
+  for (i = 0; i < DATA_PAGES * WORDS; i++)
+    if (data[i] != (i % WORDS == 0 ? (int) (i / WORDS + 1) : 0))
+      fail ("%s: data word %zu is %d", who, i, data[i]);
+  for (i = 0; i < BSS_PAGES * WORDS; i += WORDS)
+    {
+      if (bss[i] != 0 || bss[i + WORDS - 1] != 0)
+        fail ("%s: bss page %zu is not zeroed", who, i / WORDS);
+      bss[i] = tag;
+    }
+  for (i = 0; i < BSS_PAGES * WORDS; i += WORDS)
+    if (bss[i] != tag)
+      fail ("%s: bss page %zu is corrupted", who, i / WORDS);
+  msg ("%s: segments are intact", who);
+}
+
+void
+test_main (void)
+{
+  pid_t pid = fork ("child");
+
+  if (pid == 0)
+    {
+      check_segments ("child", 'c');
+      exit (0);
+    }
+  CHECK (wait (pid) == 0, "wait for child");
+  check_segments ("parent", 'p');
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(lazy-segment) begin
+(lazy-segment) child: segments are intact
+(lazy-segment) wait for child
+(lazy-segment) parent: segments are intact
+(lazy-segment) end
+EOF
+pass;
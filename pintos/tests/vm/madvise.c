@@ -0,0 +1,61 @@
+/* Exercises madvise(): DONTNEED drops anonymous pages and clean
+   file pages but keeps dirty ones, WILLNEED reads pages ahead of
+   use in the background, and bad ranges or advice are rejected. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+
+static char buf[2 * PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  size_t i;
+  int handle;
+
+  /* Anonymous pages read back as zeros once dropped. */
+  memset (buf, 0xa5, sizeof buf);
+  CHECK (madvise (buf, sizeof buf, MADV_DONTNEED) == 0,
+         "madvise anonymous DONTNEED");
+  for (i = 0; i < sizeof buf; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu is %d after DONTNEED", i, buf[i]);
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mmap (actual, 4096, 1, handle, 0) != MAP_FAILED,
+         "mmap \"sample.txt\"");
+
+  CHECK (madvise (actual, PAGE_SIZE, MADV_WILLNEED) == 0,
+         "madvise WILLNEED");
+  if (memcmp (actual, sample, strlen (sample)))
+    fail ("read of prefetched page reported bad data");
+  CHECK (get_phys_addr (actual) != 0, "page is loaded");
+  CHECK (madvise (actual, PAGE_SIZE, MADV_SEQUENTIAL) == 0,
+         "madvise SEQUENTIAL");
+  CHECK (madvise (actual, PAGE_SIZE, MADV_RANDOM) == 0, "madvise RANDOM");
+
+  /* A clean file page is dropped and reloaded from the file. */
+  CHECK (madvise (actual, PAGE_SIZE, MADV_DONTNEED) == 0,
+         "madvise clean DONTNEED");
+  CHECK (get_phys_addr (actual) == 0, "page is dropped");
+  if (memcmp (actual, sample, strlen (sample)))
+    fail ("read of mmap'd file reported bad data");
+
+  /* A dirty one is kept. */
+  actual[0] = '!';
+  CHECK (madvise (actual, PAGE_SIZE, MADV_DONTNEED) == 0,
+         "madvise dirty DONTNEED");
+  CHECK (actual[0] == '!', "write is kept");
+
+  CHECK (madvise (actual + 1, PAGE_SIZE, MADV_DONTNEED) == -1,
+         "madvise misaligned");
+  CHECK (madvise (actual, 2 * PAGE_SIZE, MADV_WILLNEED) == -1,
+         "madvise unmapped");
+  CHECK (madvise (actual, PAGE_SIZE, 42) == -1, "madvise bad advice");
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise) begin
+(madvise) madvise anonymous DONTNEED
+(madvise) open "sample.txt"
+(madvise) mmap "sample.txt"
+(madvise) madvise WILLNEED
+(madvise) page is loaded
+(madvise) madvise SEQUENTIAL
+(madvise) madvise RANDOM
+(madvise) madvise clean DONTNEED
+(madvise) page is dropped
+(madvise) madvise dirty DONTNEED
+(madvise) write is kept
+(madvise) madvise misaligned
+(madvise) madvise unmapped
+(madvise) madvise bad advice
+(madvise) end
+EOF
+pass;
@@ -0,0 +1,48 @@
+/* Maps anonymous memory, private and shared, and checks that a
+   child's writes reach the parent only through the shared one, and
+   that shared memory, which is never evicted, is limited. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (2 * 4096)
+#define HUGE_SIZE (256 * 1024 * 1024)
+
+void
+test_main (void)
+{
+  char *private = (char *) 0x10000000;
+  char *shared = (char *) 0x20000000;
+  size_t i;
+  int pid;
+
+  CHECK (mmap (private, SIZE, 1, MAP_ANONYMOUS, 0) != MAP_FAILED,
+         "mmap private anonymous");
+  CHECK (mmap (shared, SIZE, 1 | MAP_SHARED, MAP_ANONYMOUS, 0) != MAP_FAILED,
+         "mmap shared anonymous");
+  for (i = 0; i < SIZE; i++)
+    if (private[i] != 0 || shared[i] != 0)
+      fail ("anonymous memory is not zeroed at byte %zu", i);
+  private[0] = 'p';
+
+  if ((pid = fork ("child")))
+    {
+      CHECK (wait (pid) == 0, "wait for child");
+      CHECK (private[0] == 'p', "private page is unchanged");
+      CHECK (shared[0] == 'c' && shared[SIZE - 1] == 'c',
+             "child's writes to the shared pages are visible");
+      munmap (shared);
+      munmap (private);
+      CHECK (mmap (shared, HUGE_SIZE, 1 | MAP_SHARED, MAP_ANONYMOUS, 0)
+             == MAP_FAILED, "mmap 256 MB shared anonymous fails");
+    }
+  else
+    {
+      private[0] = 'c';
+      shared[0] = 'c';
+      shared[SIZE - 1] = 'c';
+      exit (0);
+    }
+}
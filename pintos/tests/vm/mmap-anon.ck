@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-anon) begin
+(mmap-anon) mmap private anonymous
+(mmap-anon) mmap shared anonymous
+(mmap-anon) wait for child
+(mmap-anon) private page is unchanged
+(mmap-anon) child's writes to the shared pages are visible
+(mmap-anon) mmap 256 MB shared anonymous fails
+(mmap-anon) end
+EOF
+pass;
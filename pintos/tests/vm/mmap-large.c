@@ -0,0 +1,45 @@
+/* Maps 256 MB of anonymous memory, far more than physical memory,
+   touches a few pages spread over it, and checks overlap rejection
+   and unmapping. Setting up the mapping must not cost anything per
+   page. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (256 * 1024 * 1024)
+
+static const size_t offsets[] = { 0, 4096, SIZE / 2 + 12345, SIZE - 1 };
+#define OFFSET_CNT (sizeof offsets / sizeof *offsets)
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  char *page = actual + (offsets[2] & ~4095);
+  size_t i;
+
+  CHECK (mmap (actual, SIZE, 1, MAP_ANONYMOUS, 0) != MAP_FAILED,
+         "mmap 256 MB anonymous");
+  CHECK (mmap (actual + SIZE / 2, 4096, 1, MAP_ANONYMOUS, 0) == MAP_FAILED,
+         "mmap over the middle of it fails");
+
+  for (i = 0; i < OFFSET_CNT; i++)
+    {
+      if (actual[offsets[i]] != 0)
+        fail ("byte %zu is not zero", offsets[i]);
+      actual[offsets[i]] = i + 1;
+    }
+  for (i = 0; i < OFFSET_CNT; i++)
+    if (actual[offsets[i]] != (char) (i + 1))
+      fail ("byte %zu is corrupted", offsets[i]);
+  msg ("touched %zu pages", OFFSET_CNT);
+
+  /* Map the page that held offsets[2] afresh. */
+  munmap (actual);
+  CHECK (mmap (page, 4096, 1, MAP_ANONYMOUS, 0) != MAP_FAILED,
+         "mmap into the unmapped range");
+  if (actual[offsets[2]] != 0)
+    fail ("new mapping is not zeroed");
+  munmap (page);
+}
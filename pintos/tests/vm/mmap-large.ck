@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-large) begin
+(mmap-large) mmap 256 MB anonymous
+(mmap-large) mmap over the middle of it fails
+(mmap-large) touched 4 pages
+(mmap-large) mmap into the unmapped range
+(mmap-large) end
+EOF
+pass;
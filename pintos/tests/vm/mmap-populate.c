@@ -0,0 +1,39 @@
+/* Maps a file and anonymous memory with MAP_POPULATE and checks that
+   their pages are resident before they are first touched. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ANON_SIZE (4 * 4096)
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  char *anon = (char *) 0x20000000;
+  struct rusage before, after;
+  int handle;
+  size_t i;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mmap (actual, 4096, 0 | MAP_POPULATE, handle, 0) != MAP_FAILED,
+         "mmap \"sample.txt\" with MAP_POPULATE");
+  CHECK (get_phys_addr (actual) != 0, "page is loaded");
+  if (memcmp (actual, sample, strlen (sample)))
+    fail ("read of mmap'd file reported bad data");
+  munmap (actual);
+
+  CHECK (mmap (anon, ANON_SIZE, 1 | MAP_POPULATE, MAP_ANONYMOUS, 0)
+         != MAP_FAILED, "mmap anonymous with MAP_POPULATE");
+  CHECK (getrusage (&before) == 0, "getrusage");
+  for (i = 0; i < ANON_SIZE; i += 4096)
+    anon[i] = 'x';
+  CHECK (getrusage (&after) == 0, "getrusage");
+  if (after.faults != before.faults)
+    fail ("writes to populated anonymous memory took %lld faults",
+          after.faults - before.faults);
+  munmap (anon);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-populate) begin
+(mmap-populate) open "sample.txt"
+(mmap-populate) mmap "sample.txt" with MAP_POPULATE
+(mmap-populate) page is loaded
+(mmap-populate) mmap anonymous with MAP_POPULATE
+(mmap-populate) getrusage
+(mmap-populate) getrusage
+(mmap-populate) end
+EOF
+pass;
@@ -0,0 +1,44 @@
+/* Checks that msync() writes modified pages of a mapping back to
+   the file while the mapping stays in place, in both modes. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static void
+check_contents (int handle, const char *expected)
+{
+  static char buf[sizeof sample - 1];
+
+  seek (handle, 0);
+  CHECK (read (handle, buf, sizeof buf) == sizeof buf, "read \"sample.txt\"");
+  if (memcmp (buf, expected, strlen (expected)))
+    fail ("file does not hold the mapped data");
+}
+
+void
+test_main (void)
+{
+  static const char first[] = "Written back by MS_SYNC";
+  static const char second[] = "Written back by MS_ASYNC";
+  char *actual = (char *) 0x10000000;
+  int handle;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mmap (actual, 4096, 1, handle, 0) != MAP_FAILED,
+         "mmap \"sample.txt\"");
+
+  memcpy (actual, first, strlen (first));
+  CHECK (msync (actual, 4096, MS_SYNC) == 0, "msync MS_SYNC");
+  check_contents (handle, first);
+
+  memcpy (actual, second, strlen (second));
+  CHECK (msync (actual, 4096, MS_ASYNC) == 0, "msync MS_ASYNC");
+  msg ("munmap \"sample.txt\"");
+  munmap (actual);
+  check_contents (handle, second);
+
+  CHECK (msync (actual, 4096, MS_SYNC) == -1, "msync unmapped");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(msync) begin
+(msync) open "sample.txt"
+(msync) mmap "sample.txt"
+(msync) msync MS_SYNC
+(msync) read "sample.txt"
+(msync) msync MS_ASYNC
+(msync) munmap "sample.txt"
+(msync) read "sample.txt"
+(msync) msync unmapped
+(msync) end
+EOF
+pass;
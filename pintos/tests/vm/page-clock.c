@@ -0,0 +1,53 @@
+/* Streams through many more pages than the resident limit allows
+   while touching a few hot pages after every one of them, and checks
+   that the clock evicts the cold pages and leaves the hot ones
+   resident. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define HOT_CNT 4
+#define COLD_CNT 128
+#define RSS_LIMIT 32
+
+void
+test_main (void)
+{
+  char *hot = (char *) 0x10000000;
+  char *cold = (char *) 0x20000000;
+  struct rusage before, after;
+  size_t i, j;
+
+  CHECK (mmap (hot, HOT_CNT * 4096, 1, MAP_ANONYMOUS, 0) != MAP_FAILED,
+         "mmap hot pages");
+  CHECK (mmap (cold, COLD_CNT * 4096, 1, MAP_ANONYMOUS, 0) != MAP_FAILED,
+         "mmap cold pages");
+  for (j = 0; j < HOT_CNT; j++)
+    hot[j * 4096] = 0;
+  CHECK (setrsslimit (RSS_LIMIT) == 0, "setrsslimit");
+  CHECK (getrusage (&before) == 0, "getrusage");
+
+  msg ("stream through cold pages");
+  for (i = 0; i < COLD_CNT; i++)
+    {
+      cold[i * 4096] = i;
+      for (j = 0; j < HOT_CNT; j++)
+        hot[j * 4096]++;
+    }
+
+  CHECK (getrusage (&after) == 0, "getrusage");
+  for (i = 0; i < COLD_CNT; i++)
+    if (cold[i * 4096] != (char) i)
+      fail ("data in cold page %zu is corrupted", i);
+  for (j = 0; j < HOT_CNT; j++)
+    if (hot[j * 4096] != (char) COLD_CNT)
+      fail ("data in hot page %zu is corrupted", j);
+  if (after.evictions == before.evictions)
+    fail ("no page was evicted");
+  if (after.swap_ins - before.swap_ins > 2 * HOT_CNT)
+    fail ("hot pages were swapped in %lld times",
+          after.swap_ins - before.swap_ins);
+  munmap (cold);
+  munmap (hot);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-clock) begin
+(page-clock) mmap hot pages
+(page-clock) mmap cold pages
+(page-clock) setrsslimit
+(page-clock) getrusage
+(page-clock) stream through cold pages
+(page-clock) getrusage
+(page-clock) end
+EOF
+pass;
@@ -0,0 +1,78 @@
+/* Dirties a file mapping and anonymous memory that together exceed
+   physical memory, so that background reclaim has to write back file
+   pages and swap out anonymous ones while the process keeps faulting,
+   then checks that all of the data survives. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_PAGES 512          /* 2 MB. */
+#define ANON_PAGES 1536         /* 6 MB. */
+
+static void
+fill (char *base, size_t cnt, int tag)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      int *page = (int *) (base + i * 4096);
+      page[0] = tag;
+      page[1] = i;
+    }
+}
+
+static void
+verify (const char *base, size_t cnt, int tag, const char *what)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      const int *page = (const int *) (base + i * 4096);
+      if (page[0] != tag || page[1] != (int) i)
+        fail ("%s page %zu is corrupted", what, i);
+    }
+}
+
+void
+test_main (void)
+{
+  char *file_map = (char *) 0x10000000;
+  char *anon = (char *) 0x20000000;
+  struct rusage usage;
+  int handle, buf[2];
+  size_t i;
+
+  CHECK (create ("data", FILE_PAGES * 4096), "create \"data\"");
+  CHECK ((handle = open ("data")) > 1, "open \"data\"");
+  CHECK (mmap (file_map, FILE_PAGES * 4096, 1, handle, 0) != MAP_FAILED,
+         "mmap \"data\"");
+  CHECK (mmap (anon, ANON_PAGES * 4096, 1, MAP_ANONYMOUS, 0) != MAP_FAILED,
+         "mmap anonymous");
+
+  msg ("write file and anonymous pages");
+  fill (file_map, FILE_PAGES, 'f');
+  fill (anon, ANON_PAGES, 'a');
+  verify (file_map, FILE_PAGES, 'f', "file");
+  verify (anon, ANON_PAGES, 'a', "anonymous");
+  msg ("verified mapped data");
+
+  CHECK (getrusage (&usage) == 0, "getrusage");
+  if (usage.evictions == 0)
+    fail ("no page was evicted");
+
+  munmap (anon);
+  munmap (file_map);
+  for (i = 0; i < FILE_PAGES; i++)
+    {
+      seek (handle, i * 4096);
+      if (read (handle, buf, sizeof buf) != sizeof buf
+          || buf[0] != 'f' || buf[1] != (int) i)
+        fail ("page %zu of \"data\" was not written back", i);
+    }
+  msg ("verified \"data\"");
+  close (handle);
+}
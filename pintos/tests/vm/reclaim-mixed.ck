@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(reclaim-mixed) begin
+(reclaim-mixed) create "data"
+(reclaim-mixed) open "data"
+(reclaim-mixed) mmap "data"
+(reclaim-mixed) mmap anonymous
+(reclaim-mixed) write file and anonymous pages
+(reclaim-mixed) verified mapped data
+(reclaim-mixed) getrusage
+(reclaim-mixed) verified "data"
+(reclaim-mixed) end
+EOF
+pass;
@@ -0,0 +1,64 @@
+/* Shares pages copy-on-write between a parent and its child, then
+   has the child dirty more anonymous memory than fits in physical
+   memory, so that the shared frames are evicted and have to be
+   unmapped from both processes through the reverse map. Checks that
+   each process still reads its own data afterwards. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SHARED_PAGES 64
+#define ANON_PAGES 2048         /* 8 MB. */
+
+static char shared[SHARED_PAGES][4096];
+
+static void
+verify_shared (const char *who)
+{
+  int i;
+
+  for (i = 0; i < SHARED_PAGES; i++)
+    if (shared[i][0] != 's' || shared[i][1] != (char) i
+        || shared[i][4095] != 's')
+      fail ("%s: shared page %d is corrupted", who, i);
+  msg ("%s: shared pages are intact", who);
+}
+
+void
+test_main (void)
+{
+  struct rusage usage;
+  pid_t pid;
+  int i;
+
+  for (i = 0; i < SHARED_PAGES; i++)
+    {
+      memset (shared[i], 's', sizeof shared[i]);
+      shared[i][1] = i;
+    }
+
+  pid = fork ("child");
+  if (pid == 0)
+    {
+      char *anon = (char *) 0x20000000;
+
+      CHECK (mmap (anon, ANON_PAGES * 4096, 1, MAP_ANONYMOUS, 0)
+             != MAP_FAILED, "mmap anonymous");
+      for (i = 0; i < ANON_PAGES; i++)
+        anon[i * 4096] = i;
+      for (i = 0; i < ANON_PAGES; i++)
+        if (anon[i * 4096] != (char) i)
+          fail ("anonymous page %d is corrupted", i);
+      msg ("child: anonymous pages are intact");
+
+      CHECK (getrusage (&usage) == 0, "getrusage");
+      if (usage.evictions == 0)
+        fail ("no page was evicted");
+      verify_shared ("child");
+      exit (0);
+    }
+  CHECK (wait (pid) == 0, "wait for child");
+  verify_shared ("parent");
+}
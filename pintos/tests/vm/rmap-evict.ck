@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(rmap-evict) begin
+(rmap-evict) mmap anonymous
+(rmap-evict) child: anonymous pages are intact
+(rmap-evict) getrusage
+(rmap-evict) child: shared pages are intact
+(rmap-evict) wait for child
+(rmap-evict) parent: shared pages are intact
+(rmap-evict) end
+EOF
+pass;
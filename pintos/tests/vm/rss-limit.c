@@ -0,0 +1,33 @@
+/* Caps the resident set of the process and writes more pages than
+   the cap allows, checking that the process pages against itself
+   and that its data survives. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 128
+#define RSS_LIMIT 32
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  struct rusage usage;
+  size_t i;
+
+  CHECK (setrsslimit (RSS_LIMIT_MIN - 1) == -1,
+         "setrsslimit below the minimum fails");
+  CHECK (setrsslimit (RSS_LIMIT) == 0, "setrsslimit");
+  CHECK (mmap (actual, PAGE_CNT * 4096, 1, MAP_ANONYMOUS, 0) != MAP_FAILED,
+         "mmap anonymous");
+  for (i = 0; i < PAGE_CNT; i++)
+    actual[i * 4096] = i;
+  for (i = 0; i < PAGE_CNT; i++)
+    if (actual[i * 4096] != (char) i)
+      fail ("data in page %zu is corrupted", i);
+  CHECK (getrusage (&usage) == 0, "getrusage");
+  if (usage.evictions == 0)
+    fail ("no page was evicted");
+  munmap (actual);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(rss-limit) begin
+(rss-limit) setrsslimit below the minimum fails
+(rss-limit) setrsslimit
+(rss-limit) mmap anonymous
+(rss-limit) getrusage
+(rss-limit) end
+EOF
+pass;
@@ -0,0 +1,41 @@
+/* Maps, touches and unmaps an anonymous area over and over. Every
+   round allocates a struct page per page and frees them all again,
+   many slabs' worth, so that the page cache keeps giving slabs back
+   to the page allocator and carving new ones. Checks that fresh
+   pages read as zeros and that pages keep what was written to them. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 256
+#define ROUNDS 64
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  int round;
+  size_t i;
+
+  for (round = 0; round < ROUNDS; round++)
+    {
+      if (mmap (actual, PAGE_CNT * PAGE_SIZE, 1, MAP_ANONYMOUS, 0)
+          == MAP_FAILED)
+        fail ("mmap failed in round %d", round);
+
+      for (i = 0; i < PAGE_CNT; i++)
+        {
+          if (actual[i * PAGE_SIZE] != 0)
+            fail ("page %zu is not zeroed in round %d", i, round);
+          actual[i * PAGE_SIZE] = (char) (round + i + 1);
+        }
+      for (i = 0; i < PAGE_CNT; i++)
+        if (actual[i * PAGE_SIZE] != (char) (round + i + 1))
+          fail ("page %zu lost its data in round %d", i, round);
+
+      munmap (actual);
+    }
+  msg ("mapped and unmapped %d pages %d times", PAGE_CNT, ROUNDS);
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(slab-reuse) begin
+(slab-reuse) mapped and unmapped 256 pages 64 times
+(slab-reuse) end
+EOF
+pass;
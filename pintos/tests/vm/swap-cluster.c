@@ -0,0 +1,69 @@
+/* Writes incompressible anonymous pages under a small resident set
+   limit, so that most of them are swapped out to disk in order, then
+   lifts the limit and reads them back sequentially. Pages evicted
+   together sit in adjacent swap slots and are read back together,
+   so far fewer faults than pages are expected. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 128
+#define RSS_LIMIT 32
+
+static unsigned
+next (unsigned *state)
+{
+  *state = *state * 1103515245 + 12345;
+  return *state >> 16;
+}
+
+static void
+fill (unsigned char *page, unsigned seed)
+{
+  size_t i;
+
+  for (i = 0; i < 4096; i++)
+    page[i] = next (&seed);
+}
+
+static bool
+matches (const unsigned char *page, unsigned seed)
+{
+  size_t i;
+
+  for (i = 0; i < 4096; i++)
+    if (page[i] != (unsigned char) next (&seed))
+      return false;
+  return true;
+}
+
+void
+test_main (void)
+{
+  unsigned char *anon = (unsigned char *) 0x20000000;
+  struct rusage before, after;
+  size_t i;
+
+  CHECK (mmap (anon, PAGE_CNT * 4096, 1, MAP_ANONYMOUS, 0) != MAP_FAILED,
+         "mmap anonymous");
+  CHECK (setrsslimit (RSS_LIMIT) == 0, "setrsslimit %d", RSS_LIMIT);
+  for (i = 0; i < PAGE_CNT; i++)
+    fill (anon + i * 4096, i + 1);
+  CHECK (setrsslimit (0) == 0, "setrsslimit 0");
+
+  CHECK (getrusage (&before) == 0, "getrusage");
+  for (i = 0; i < PAGE_CNT; i++)
+    if (!matches (anon + i * 4096, i + 1))
+      fail ("page %zu is corrupted", i);
+  msg ("read back %d pages", PAGE_CNT);
+  CHECK (getrusage (&after) == 0, "getrusage");
+
+  if (after.swap_ins - before.swap_ins < PAGE_CNT / 2)
+    fail ("only %lld pages were swapped in",
+          after.swap_ins - before.swap_ins);
+  if (after.faults - before.faults >= PAGE_CNT / 2)
+    fail ("%lld faults to read back %d pages",
+          after.faults - before.faults, PAGE_CNT);
+  msg ("swapped in pages in clusters");
+}
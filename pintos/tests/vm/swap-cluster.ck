@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-cluster) begin
+(swap-cluster) mmap anonymous
+(swap-cluster) setrsslimit 32
+(swap-cluster) setrsslimit 0
+(swap-cluster) getrusage
+(swap-cluster) read back 128 pages
+(swap-cluster) getrusage
+(swap-cluster) swapped in pages in clusters
+(swap-cluster) end
+EOF
+pass;
@@ -0,0 +1,63 @@
+/* Swaps out pages that compress well, interleaved with pages that do
+   not, under a small resident limit, and reads them back twice, so
+   that pages make round trips through the compressed swap cache and
+   through the swap disk. */
+
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 256
+#define RSS_LIMIT 32
+
+/* Even pages are a short marker followed by zeros; odd pages are
+   pseudo-random words derived from their index. */
+static bool
+page_data (uint32_t *page, uint32_t idx, bool check)
+{
+  uint32_t seed = idx;
+  size_t i;
+
+  for (i = 0; i < 4096 / sizeof *page; i++)
+    {
+      uint32_t word;
+
+      seed = seed * 1103515245 + 12345;
+      if (idx % 2 == 0)
+        word = i < 4 ? idx + i : 0;
+      else
+        word = seed;
+      if (!check)
+        page[i] = word;
+      else if (page[i] != word)
+        return false;
+    }
+  return true;
+}
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  struct rusage usage;
+  int pass;
+  size_t i;
+
+  CHECK (setrsslimit (RSS_LIMIT) == 0, "setrsslimit");
+  CHECK (mmap (actual, PAGE_CNT * 4096, 1, MAP_ANONYMOUS, 0) != MAP_FAILED,
+         "mmap anonymous");
+  for (i = 0; i < PAGE_CNT; i++)
+    page_data ((uint32_t *) (actual + i * 4096), i, false);
+  for (pass = 0; pass < 2; pass++)
+    for (i = 0; i < PAGE_CNT; i++)
+      if (!page_data ((uint32_t *) (actual + i * 4096), i, true))
+        fail ("data in page %zu is corrupted in pass %d", i, pass);
+  msg ("read back every page twice");
+
+  CHECK (getrusage (&usage) == 0, "getrusage");
+  if (usage.swap_ins < PAGE_CNT)
+    fail ("only %lld pages were swapped in", usage.swap_ins);
+  munmap (actual);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-compress) begin
+(swap-compress) setrsslimit
+(swap-compress) mmap anonymous
+(swap-compress) read back every page twice
+(swap-compress) getrusage
+(swap-compress) end
+EOF
+pass;
@@ -0,0 +1,59 @@
+/* Swaps out a mapping full of incompressible data, reads it back and
+   unmaps it, over and over, until more pages have gone to swap than
+   the swap disk holds. Passes only if swap slots are freed again
+   once their pages are read back or unmapped. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 256
+#define ROUNDS 6
+#define RSS_LIMIT 32
+
+/* Fills or checks PAGE with pseudo-random words derived from SEED.
+   Returns false if a check finds a mismatch. */
+static bool
+page_data (uint32_t *page, uint32_t seed, bool check)
+{
+  size_t i;
+
+  for (i = 0; i < 4096 / sizeof *page; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      if (!check)
+        page[i] = seed;
+      else if (page[i] != seed)
+        return false;
+    }
+  return true;
+}
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  struct rusage usage;
+  int round;
+  size_t i;
+
+  CHECK (setrsslimit (RSS_LIMIT) == 0, "setrsslimit");
+  msg ("swap out and back in %d pages %d times", PAGE_CNT, ROUNDS);
+  for (round = 0; round < ROUNDS; round++)
+    {
+      if (mmap (actual, PAGE_CNT * 4096, 1, MAP_ANONYMOUS, 0) == MAP_FAILED)
+        fail ("mmap anonymous failed in round %d", round);
+      for (i = 0; i < PAGE_CNT; i++)
+        page_data ((uint32_t *) (actual + i * 4096), round * PAGE_CNT + i,
+                   false);
+      for (i = 0; i < PAGE_CNT; i++)
+        if (!page_data ((uint32_t *) (actual + i * 4096),
+                        round * PAGE_CNT + i, true))
+          fail ("data in page %zu is corrupted in round %d", i, round);
+      munmap (actual);
+    }
+  CHECK (getrusage (&usage) == 0, "getrusage");
+  if (usage.evictions < (ROUNDS - 1) * PAGE_CNT)
+    fail ("only %lld pages were evicted", usage.evictions);
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-reuse) begin
+(swap-reuse) setrsslimit
+(swap-reuse) swap out and back in 256 pages 6 times
+(swap-reuse) getrusage
+(swap-reuse) end
+EOF
+pass;
@@ -0,0 +1,28 @@
+/* Runs a second copy of this program and checks that both copies
+   execute their code out of the same frame. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+int
+main (int argc, char *argv[] UNUSED)
+{
+  pid_t pid;
+  int pfn;
+
+  test_name = "text-share";
+  pfn = (uintptr_t) get_phys_addr ((void *) main) >> 12;
+
+  /* The second copy only reports where its code is. */
+  if (argc > 1)
+    return pfn;
+
+  msg ("begin");
+  pid = fork ("child");
+  if (pid == 0)
+    exit (exec ("text-share child"));
+  CHECK (wait (pid) == pfn, "child runs on the parent's text frame");
+  msg ("end");
+  return 0;
+}
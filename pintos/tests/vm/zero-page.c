@@ -0,0 +1,42 @@
+/* Reads untouched anonymous pages, which must all map one shared
+   zero frame, then writes one of them and checks that only that page
+   gets a frame of its own and the others still read as zeros. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 4
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  void *zero;
+  int i;
+
+  CHECK (mmap (actual, PAGE_CNT * 4096, 1, MAP_ANONYMOUS, 0) != MAP_FAILED,
+         "mmap anonymous");
+  for (i = 0; i < PAGE_CNT; i++)
+    if (actual[i * 4096] != 0)
+      fail ("page %d is not zeroed", i);
+  zero = get_phys_addr (actual);
+  for (i = 1; i < PAGE_CNT; i++)
+    if (get_phys_addr (actual + i * 4096) != zero)
+      fail ("page %d does not map the zero frame", i);
+  msg ("read pages share one frame");
+
+  actual[0] = 'x';
+  CHECK (get_phys_addr (actual) != zero, "written page has its own frame");
+  for (i = 1; i < PAGE_CNT; i++)
+    {
+      if (actual[i * 4096] != 0 || actual[i * 4096 + 4095] != 0)
+        fail ("write to page 0 showed up in page %d", i);
+      if (get_phys_addr (actual + i * 4096) != zero)
+        fail ("page %d no longer maps the zero frame", i);
+    }
+  msg ("other pages still read zeros");
+  if (actual[0] != 'x' || actual[1] != 0)
+    fail ("written page is corrupted");
+  munmap (actual);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(zero-page) begin
+(zero-page) mmap anonymous
+(zero-page) read pages share one frame
+(zero-page) written page has its own frame
+(zero-page) other pages still read zeros
+(zero-page) end
+EOF
+pass;
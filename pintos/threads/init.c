@@ -35,8 +35,10 @@
 #endif
 #ifdef FILESYS
 #include "devices/disk.h"
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
+#include "filesys/page_cache.h"
 #endif
 
 /* Page-map-level-4 with kernel mappings only. */
@@ -231,6 +233,16 @@ parse_options (char **argv) {
 			user_page_limit = atoi (value);
 		else if (!strcmp (name, "-threads-tests"))
 			thread_tests = true;
+#endif
+#ifdef VM
+		else if (!strcmp (name, "-fa"))
+			vm_fault_around = atoi (value);
+		else if (!strcmp (name, "-reclaim-low"))
+			vm_reclaim_low = atoi (value);
+		else if (!strcmp (name, "-reclaim-high"))
+			vm_reclaim_high = atoi (value);
+		else if (!strcmp (name, "-rusage"))
+			vm_print_rusage = true;
 #endif
 		else
 			PANIC ("unknown option `%s' (use -h for help)", name);
@@ -333,6 +345,12 @@ usage (void) {
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+			"  -fa=PAGES          Load up to PAGES file pages per page fault (8).\n"
+			"  -reclaim-low=PAGES Start background reclaim below PAGES free frames.\n"
+			"  -reclaim-high=PAGES Reclaim until PAGES frames are free.\n"
+			"  -rusage            Print paging statistics of exiting processes.\n"
 #endif
 			);
 	power_off ();
@@ -359,7 +377,12 @@ static void
 print_stats (void) {
 	timer_print_stats ();
 	thread_print_stats ();
+#ifdef VM
+	vm_anon_print_stats ();
+#endif
 #ifdef FILESYS
+	page_cache_print_stats ();
+	dcache_print_stats ();
 	disk_print_stats ();
 #endif
 	console_print_stats ();
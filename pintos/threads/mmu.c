@@ -7,12 +7,44 @@
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "intrinsic.h"
+#ifdef VM
+#include "vm/vm.h"
+#endif
+
+static uint64_t *pde_walk (uint64_t *pml4, uint64_t va, bool create);
+
+/* Replaces the 2 MiB mapping in page directory entry *PDE by a page
+ * table that maps the same frames 4 KiB at a time, with the same
+ * permissions and accessed/dirty bits. Returns false if no page is
+ * left for the page table. */
+static bool
+pde_split (uint64_t *pde) {
+	uint64_t *pt = palloc_get_page (0);
+	uint64_t pa = PTE_ADDR (*pde) & ~(HUGE_PGSIZE - 1);
+	uint64_t flags = *pde & PTE_FLAGS & ~PTE_PS;
+
+	if (pt == NULL)
+		return false;
+
+	for (unsigned i = 0; i < HUGE_PGCNT; i++)
+		pt[i] = (pa + i * PGSIZE) | flags;
+	*pde = vtop (pt) | PTE_U | PTE_W | PTE_P;
+#ifdef VM
+	vm_huge_unmark (ptov (pa));
+#endif
+	return true;
+}
 
 static uint64_t *
 pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 	int idx = PDX (va);
 	if (pdp) {
 		uint64_t *pte = (uint64_t *) pdp[idx];
+		/* Callers change 4 KiB entries, so a huge page is split.
+		 * Queries go through pte_lookup() instead. */
+		if (((uint64_t) pte & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS)
+				&& !pde_split (&pdp[idx]))
+			return NULL;
 		if (!((uint64_t) pte & PTE_P)) {
 			if (create) {
 				uint64_t *new_page = palloc_get_page (PAL_ZERO);
@@ -121,7 +153,12 @@ static bool
 pgdir_for_each (uint64_t *pdp, pte_for_each_func *func, void *aux,
 		unsigned pml4_index, unsigned pdp_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
-		uint64_t *pte = ptov((uint64_t *) pdp[i]);
+		uint64_t *pte;
+
+		if ((pdp[i] & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS)
+				&& !pde_split (&pdp[i]))
+			return false;
+		pte = ptov((uint64_t *) pdp[i]);
 		if (((uint64_t) pte) & PTE_P)
 			if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
 					pml4_index, pdp_index, i))
@@ -169,6 +206,9 @@ static void
 pgdir_destroy (uint64_t *pdp) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
+		/* Huge pages belong to the VM layer, which unmaps them. */
+		if (pdp[i] & PTE_PS)
+			continue;
 		if (((uint64_t) pte) & PTE_P)
 			pt_destroy (PTE_ADDR (pte));
 	}
@@ -206,6 +246,22 @@ pml4_activate (uint64_t *pml4) {
 	lcr3 (vtop (pml4 ? pml4 : base_pml4));
 }
 
+/* Returns the entry mapping user virtual address VADDR in PML4: its
+ * page table entry, or the page directory entry of the huge page it
+ * lies in, which keeps the permission, accessed and dirty bits at the
+ * same places. Unlike pml4e_walk(), never splits a huge page, so it
+ * is for queries only. Returns NULL if there is no such entry. */
+static uint64_t *
+pte_lookup (uint64_t *pml4, const void *vaddr) {
+	uint64_t *pde = pde_walk (pml4, (uint64_t) vaddr, false);
+
+	if (pde == NULL || !(*pde & PTE_P))
+		return NULL;
+	if (*pde & PTE_PS)
+		return pde;
+	return (uint64_t *) ptov (PTE_ADDR (*pde)) + PTX (vaddr);
+}
+
 /* Looks up the physical address that corresponds to user virtual
  * address UADDR in pml4.  Returns the kernel virtual address
  * corresponding to that physical address, or a null pointer if
@@ -214,11 +270,15 @@ void *
 pml4_get_page (uint64_t *pml4, const void *uaddr) {
 	ASSERT (is_user_vaddr (uaddr));
 
-	uint64_t *pte = pml4e_walk (pml4, (uint64_t) uaddr, 0);
+	uint64_t *pte = pte_lookup (pml4, uaddr);
 
-	if (pte && (*pte & PTE_P))
-		return ptov (PTE_ADDR (*pte)) + pg_ofs (uaddr);
-	return NULL;
+	if (pte == NULL || !(*pte & PTE_P))
+		return NULL;
+	/* Bit 7 of a 4 KiB entry is PAT, which is never set. */
+	if (*pte & PTE_PS)
+		return ptov (PTE_ADDR (*pte) & ~(HUGE_PGSIZE - 1))
+			+ (uint64_t) uaddr % HUGE_PGSIZE;
+	return ptov (PTE_ADDR (*pte)) + pg_ofs (uaddr);
 }
 
 /* Adds a mapping in page map level 4 PML4 from user virtual page
@@ -268,13 +328,13 @@ pml4_clear_page (uint64_t *pml4, void *upage) {
  * Returns false if PML4 contains no PTE for VPAGE. */
 
 bool pml4_is_writable (uint64_t *pml4, const void *vpage) {
-	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
+	uint64_t *pte = pte_lookup (pml4, vpage);
 	return pte != NULL && (*pte & PTE_W) != 0;
 }
 
 bool
 pml4_is_dirty (uint64_t *pml4, const void *vpage) {
-	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
+	uint64_t *pte = pte_lookup (pml4, vpage);
 	return pte != NULL && (*pte & PTE_D) != 0;
 }
 
@@ -294,13 +354,29 @@ pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
 	}
 }
 
+/* Sets the writable bit to WRITABLE in the PTE for virtual page
+ * VPAGE in PML4, keeping the accessed and dirty bits. */
+void
+pml4_set_writable (uint64_t *pml4, const void *vpage, bool writable) {
+	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
+	if (pte) {
+		if (writable)
+			*pte |= PTE_W;
+		else
+			*pte &= ~(uint64_t) PTE_W;
+
+		if (rcr3 () == vtop (pml4))
+			invlpg ((uint64_t) vpage);
+	}
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PML4 has been
  * accessed recently, that is, between the time the PTE was
  * installed and the last time it was cleared.  Returns false if
  * PML4 contains no PTE for VPAGE. */
 bool
 pml4_is_accessed (uint64_t *pml4, const void *vpage) {
-	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
+	uint64_t *pte = pte_lookup (pml4, vpage);
 	return pte != NULL && (*pte & PTE_A) != 0;
 }
 
@@ -319,3 +395,76 @@ pml4_set_accessed (uint64_t *pml4, const void *vpage, bool accessed) {
 			invlpg ((uint64_t) vpage);
 	}
 }
+
+/* Returns the page directory entry for VA in PML4, creating the upper
+ * levels if CREATE is true. Returns NULL if they are missing and
+ * CREATE is false, or if memory runs out. */
+static uint64_t *
+pde_walk (uint64_t *pml4, uint64_t va, bool create) {
+	uint64_t *table = pml4;
+	unsigned idx[2] = { PML4 (va), PDPE (va) };
+
+	for (int level = 0; level < 2; level++) {
+		uint64_t *entry = &table[idx[level]];
+
+		if (!(*entry & PTE_P)) {
+			uint64_t *new_page;
+
+			if (!create || (new_page = palloc_get_page (PAL_ZERO)) == NULL)
+				return NULL;
+			*entry = vtop (new_page) | PTE_U | PTE_W | PTE_P;
+		}
+		table = ptov (PTE_ADDR (*entry));
+	}
+	return &table[PDX (va)];
+}
+
+/* Maps the 2 MiB of user virtual memory at UPAGE to the physically
+ * contiguous kernel pages at KPAGE with a single page directory entry.
+ * Both must be 2 MiB aligned, and nothing may be mapped in the range;
+ * an empty page table left there is freed. Returns false if that is
+ * not the case or memory runs out. */
+bool
+pml4_set_huge_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
+	uint64_t *pde;
+
+	ASSERT ((uint64_t) upage % HUGE_PGSIZE == 0);
+	ASSERT ((uint64_t) kpage % HUGE_PGSIZE == 0);
+	ASSERT (is_user_vaddr (upage));
+	ASSERT (pml4 != base_pml4);
+
+	pde = pde_walk (pml4, (uint64_t) upage, true);
+	if (pde == NULL)
+		return false;
+
+	if (*pde & PTE_P) {
+		uint64_t *pt = ptov (PTE_ADDR (*pde));
+
+		if (*pde & PTE_PS)
+			return false;
+		for (unsigned i = 0; i < PGSIZE / sizeof *pt; i++)
+			if (pt[i] & PTE_P)
+				return false;
+		palloc_free_page (pt);
+	}
+
+	*pde = vtop (kpage) | PTE_PS | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+	if (rcr3 () == vtop (pml4))
+		invlpg ((uint64_t) upage);
+	return true;
+}
+
+/* Turns the huge page at UPAGE into 512 ordinary mappings of the same
+ * frames. Returns true, doing nothing, if UPAGE is not mapped by a
+ * huge page, and false if memory for the page table runs out. */
+bool
+pml4_split_huge_page (uint64_t *pml4, void *upage) {
+	uint64_t *pde;
+
+	ASSERT ((uint64_t) upage % HUGE_PGSIZE == 0);
+
+	pde = pde_walk (pml4, (uint64_t) upage, false);
+	if (pde == NULL || (*pde & (PTE_P | PTE_PS)) != (PTE_P | PTE_PS))
+		return true;
+	return pde_split (pde);
+}
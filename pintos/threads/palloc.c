@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -31,6 +32,7 @@ struct pool {
 	struct lock lock;               /* Mutual exclusion. */
 	struct bitmap *used_map;        /* Bitmap of free pages. */
 	uint8_t *base;                  /* Base of pool. */
+	size_t free_cnt;                /* Number of free pages. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -42,6 +44,7 @@ static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static void pool_count (struct pool *, size_t page_cnt, bool freed);
 
 /* multiboot info */
 struct multiboot_info {
@@ -250,6 +253,10 @@ palloc_init (void) {
 	printf ("\text_mem: 0x%llx ~ 0x%llx (Usable: %'llu kB)\n",
 		  ext_mem.start, ext_mem.end, ext_mem.size / 1024);
 	populate_pools (&base_mem, &ext_mem);
+	kernel_pool.free_cnt = bitmap_count (kernel_pool.used_map, 0,
+			bitmap_size (kernel_pool.used_map), false);
+	user_pool.free_cnt = bitmap_count (user_pool.used_map, 0,
+			bitmap_size (user_pool.used_map), false);
 	return ext_mem.end;
 }
 
@@ -265,6 +272,8 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 
 	lock_acquire (&pool->lock);
 	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+	if (page_idx != BITMAP_ERROR)
+		pool_count (pool, page_cnt, false);
 	lock_release (&pool->lock);
 	void *pages;
 
@@ -284,6 +293,44 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 	return pages;
 }
 
+/* Like palloc_get_multiple(), but the first page's kernel virtual
+   address is a multiple of ALIGN pages, which must be a power of
+   two.  Used for huge pages, whose frames must also be physically
+   aligned. */
+void *
+palloc_get_aligned (enum palloc_flags flags, size_t page_cnt, size_t align) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	size_t bm_size = bitmap_size (pool->used_map);
+	size_t page_idx = BITMAP_ERROR;
+	void *pages = NULL;
+
+	ASSERT (align > 0 && (align & (align - 1)) == 0);
+
+	lock_acquire (&pool->lock);
+	for (size_t idx = (align - pg_no (pool->base) % align) % align;
+			idx + page_cnt <= bm_size; idx += align)
+		if (!bitmap_contains (pool->used_map, idx, page_cnt, true)) {
+			bitmap_set_multiple (pool->used_map, idx, page_cnt, true);
+			pool_count (pool, page_cnt, false);
+			page_idx = idx;
+			break;
+		}
+	lock_release (&pool->lock);
+
+	if (page_idx != BITMAP_ERROR)
+		pages = pool->base + PGSIZE * page_idx;
+
+	if (pages) {
+		if (flags & PAL_ZERO)
+			memset (pages, 0, PGSIZE * page_cnt);
+	} else {
+		if (flags & PAL_ASSERT)
+			PANIC ("palloc_get: out of pages");
+	}
+
+	return pages;
+}
+
 /* Obtains a single free page and returns its kernel virtual
    address.
    If PAL_USER is set, the page is obtained from the user pool,
@@ -320,6 +367,7 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 #endif
 	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
 	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	pool_count (pool, page_cnt, true);
 }
 
 /* Frees the page at PAGE. */
@@ -328,6 +376,21 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
+/* Stores the base address and the number of pages of the user
+   pool into *BASE and *PAGE_CNT.  The VM frame table covers
+   exactly this range. */
+void
+palloc_user_pool_range (void **base, size_t *page_cnt) {
+	*base = user_pool.base;
+	*page_cnt = bitmap_size (user_pool.used_map);
+}
+
+/* Returns the number of free pages in the user pool. */
+size_t
+palloc_user_free_cnt (void) {
+	return user_pool.free_cnt;
+}
+
 /* Initializes pool P as starting at START and ending at END */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
@@ -347,6 +410,20 @@ init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
 	*bm_base += bm_pages;
 }
 
+/* Adjusts the free page count of POOL by PAGE_CNT.  Pages are
+   freed without the pool lock, also from the scheduler, so the
+   update is done with interrupts off. */
+static void
+pool_count (struct pool *pool, size_t page_cnt, bool freed) {
+	enum intr_level old_level = intr_disable ();
+
+	if (freed)
+		pool->free_cnt += page_cnt;
+	else
+		pool->free_cnt -= page_cnt;
+	intr_set_level (old_level);
+}
+
 /* Returns true if PAGE was allocated from POOL,
    false otherwise. */
 static bool
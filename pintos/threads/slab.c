@@ -0,0 +1,174 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Object caches for small fixed-size kernel objects that are allocated
+   and freed at a high rate.
+
+   Each cache owns a set of "slabs", pages obtained from the page
+   allocator and carved into objects of the cache's size.  Every slab
+   threads its free objects on a list of its own.  The cache keeps the
+   slabs that have free objects on a list, partially used ones in front
+   of unused ones, so that allocations fill up slabs that are already
+   in use before touching fresh ones.
+
+   A slab that becomes entirely free is not given back right away: up
+   to SLAB_EMPTY_MAX of them stay with the cache, so that a workload
+   that repeatedly allocates and frees a burst of objects keeps reusing
+   the same pages instead of going through the page allocator.
+
+   Unlike malloc(), a cache serves exactly one size, so no space is lost
+   to rounding up to a power of 2, and each cache has its own lock. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab0bec
+
+/* Number of unused slabs a cache holds on to. */
+#define SLAB_EMPTY_MAX 2
+
+/* Slab header, at the start of the slab's page. */
+struct slab {
+	unsigned magic;             /* Always set to SLAB_MAGIC. */
+	struct slab_cache *cache;   /* Owning cache. */
+	struct list_elem elem;      /* In cache's slab list, if not full. */
+	size_t free_cnt;            /* Number of free objects. */
+	void *free;                 /* First free object. */
+};
+
+/* The first bytes of a free object link it to the next one. */
+struct free_obj {
+	struct free_obj *next;
+};
+
+static struct slab *obj_to_slab (void *);
+
+/* Initializes CACHE, named NAME, to hand out objects of SIZE bytes. */
+void
+slab_cache_init (struct slab_cache *cache, const char *name, size_t size) {
+	ASSERT (cache != NULL);
+
+	if (size < sizeof (struct free_obj))
+		size = sizeof (struct free_obj);
+
+	cache->name = name;
+	cache->obj_size = ROUND_UP (size, sizeof (void *));
+	cache->objs_per_slab = (PGSIZE - sizeof (struct slab)) / cache->obj_size;
+	ASSERT (cache->objs_per_slab > 0);
+	list_init (&cache->slabs);
+	cache->slab_cnt = 0;
+	cache->empty_cnt = 0;
+	lock_init (&cache->lock);
+}
+
+/* Carves a new slab for CACHE and adds it to CACHE's slab list.
+   Returns false if no page is available. */
+static bool
+slab_grow (struct slab_cache *cache) {
+	struct slab *s = palloc_get_page (0);
+	uint8_t *obj;
+	size_t i;
+
+	if (s == NULL)
+		return false;
+
+	s->magic = SLAB_MAGIC;
+	s->cache = cache;
+	s->free_cnt = cache->objs_per_slab;
+	s->free = NULL;
+	obj = (uint8_t *) (s + 1) + (cache->objs_per_slab - 1) * cache->obj_size;
+	for (i = 0; i < cache->objs_per_slab; i++, obj -= cache->obj_size) {
+		struct free_obj *f = (struct free_obj *) obj;
+		f->next = s->free;
+		s->free = f;
+	}
+
+	list_push_back (&cache->slabs, &s->elem);
+	cache->slab_cnt++;
+	cache->empty_cnt++;
+	return true;
+}
+
+/* Obtains and returns a new object from CACHE.
+   Returns a null pointer if memory is not available. */
+void *
+slab_alloc (struct slab_cache *cache) {
+	struct free_obj *f;
+	struct slab *s;
+
+	lock_acquire (&cache->lock);
+
+	if (list_empty (&cache->slabs) && !slab_grow (cache)) {
+		lock_release (&cache->lock);
+		return NULL;
+	}
+
+	s = list_entry (list_front (&cache->slabs), struct slab, elem);
+	if (s->free_cnt == cache->objs_per_slab)
+		cache->empty_cnt--;
+	f = s->free;
+	s->free = f->next;
+	if (--s->free_cnt == 0)
+		list_remove (&s->elem);
+
+	lock_release (&cache->lock);
+	return f;
+}
+
+/* Frees object P, which must have been obtained with slab_alloc(). */
+void
+slab_free (void *p) {
+	struct slab_cache *cache;
+	struct free_obj *f = p;
+	struct slab *s;
+
+	if (p == NULL)
+		return;
+
+	s = obj_to_slab (p);
+	cache = s->cache;
+
+#ifndef NDEBUG
+	/* Clear the object to help detect use-after-free bugs. */
+	memset (p, 0xcc, cache->obj_size);
+#endif
+
+	lock_acquire (&cache->lock);
+
+	f->next = s->free;
+	s->free = f;
+	if (s->free_cnt++ == 0)
+		list_push_front (&cache->slabs, &s->elem);
+
+	if (s->free_cnt == cache->objs_per_slab) {
+		list_remove (&s->elem);
+		if (cache->empty_cnt < SLAB_EMPTY_MAX) {
+			/* Keep it for reuse, behind the slabs still in use. */
+			list_push_back (&cache->slabs, &s->elem);
+			cache->empty_cnt++;
+		} else {
+			cache->slab_cnt--;
+			palloc_free_page (s);
+		}
+	}
+
+	lock_release (&cache->lock);
+}
+
+/* Returns the slab that object P is inside. */
+static struct slab *
+obj_to_slab (void *p) {
+	struct slab *s = pg_round_down (p);
+
+	/* Check that the slab is valid. */
+	ASSERT (s != NULL);
+	ASSERT (s->magic == SLAB_MAGIC);
+
+	/* Check that the object is properly aligned for the slab. */
+	ASSERT ((pg_ofs (p) - sizeof *s) % s->cache->obj_size == 0);
+
+	return s;
+}
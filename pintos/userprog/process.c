@@ -27,6 +27,7 @@
 #ifdef VM
 #include "vm/file.h"
 #include "vm/vm.h"
+#include "vm/vma.h"
 #endif
 
 struct fork_struct {
@@ -164,6 +165,7 @@ static void __do_fork(void* aux) {
 
     process_activate(current);
 #ifdef VM
+    current->rss_limit = parent->rss_limit;
     supplemental_page_table_init(&current->spt);
     if (!supplemental_page_table_copy(&current->spt, &parent->spt)) goto error;
 #else
@@ -260,6 +262,13 @@ void process_exit(void) {
 
     if (cur->pml4 == NULL) return;
     printf("%s: exit(%d)\n", cur->name, cur->my_entry->exit_status);
+#ifdef VM
+    if (vm_print_rusage)
+        printf("%s: %lld faults, %lld lazy loads, %lld swap-ins, %lld file re-reads, "
+               "%lld evictions, %lld stack growths\n",
+               cur->name, cur->rusage.faults, cur->rusage.lazy_loads, cur->rusage.swap_ins,
+               cur->rusage.file_reads, cur->rusage.evictions, cur->rusage.stack_growths);
+#endif
     if (cur->current_file) {
         file_allow_write(cur->current_file);
         lock_acquire(&file_lock);
@@ -268,13 +277,6 @@ void process_exit(void) {
         cur->current_file = NULL;
     }
 
-#ifdef VM
-    while (!list_empty(&cur->mmap_list)) {
-        struct mmap_file *map = list_entry (list_begin (&cur->mmap_list), struct mmap_file, elem);
-        do_munmap (map->start);
-    }
-#endif
-
     fdt_list_cleanup(cur);
     process_cleanup();
     sema_up(&cur->my_entry->wait_sema);
@@ -599,17 +601,20 @@ static bool install_page(void* upage, void* kpage, bool writable) {
  * upper block. */
 
 bool lazy_load_segment(struct page *page, void *aux) {
-    struct lazy_load_info *info = aux;
+    struct segment *seg = aux;
     void *kva = page->frame->kva;
+    size_t page_read_bytes;
+    off_t ofs;
 
-    off_t read_bytes = file_read_at(info->file, kva, info->page_read_bytes, info->ofs);
+    segment_locate(seg, page->va, &ofs, &page_read_bytes);
+    off_t read_bytes = file_read_at(seg->file, kva, page_read_bytes, ofs);
 
-    bool success = (read_bytes == (off_t)info->page_read_bytes);
+    bool success = (read_bytes == (off_t)page_read_bytes);
 
     if (success)
-        memset(kva + info->page_read_bytes, 0, info->page_zero_bytes);
+        memset(kva + page_read_bytes, 0, PGSIZE - page_read_bytes);
 
-    free (info);
+    segment_put(seg);
     return true;
 }
 
@@ -634,38 +639,19 @@ static bool load_segment(struct file* file, off_t ofs, uint8_t* upage, uint32_t
     ASSERT(pg_ofs(upage) == 0);
     ASSERT(ofs % PGSIZE == 0);
 
-    while (read_bytes > 0 || zero_bytes > 0) {
-        size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-        size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-        struct lazy_load_info* aux = malloc(sizeof *aux);
-
-        if (aux == NULL) 
-            return false;
-
-        aux->file = file_reopen(file);  
+    /* The whole segment becomes one memory area; its pages are built
+     * and loaded on first access. Read-only segment pages are shared
+     * through the text cache. */
+    enum vm_type type = writable ? VM_ANON : VM_ANON | VM_TEXT;
+    struct file* seg_file = file_reopen(file);
 
-        if (aux->file == NULL) {
-            free(aux);
-            return false;
-        }
+    if (seg_file == NULL) return false;
 
-        aux->ofs = ofs;
-        aux->page_read_bytes = page_read_bytes;
-        aux->page_zero_bytes = page_zero_bytes;
-
-        if (!vm_alloc_page_with_initializer(VM_ANON, upage, writable, lazy_load_segment, aux)) {
-            file_close(aux->file);
-            free(aux);
-            return false;
-        }
-
-        read_bytes -= page_read_bytes;
-        zero_bytes -= page_zero_bytes;
-        upage += PGSIZE;
-        ofs += page_read_bytes;
+    if (vma_create(&thread_current()->spt, upage, upage + read_bytes + zero_bytes, type, writable,
+                   seg_file, ofs, read_bytes) == NULL) {
+        file_close(seg_file);
+        return false;
     }
-
     return true;
 }
 
@@ -674,6 +660,10 @@ static bool setup_stack(struct intr_frame* if_) {
     struct thread* cur = thread_current();
     void* stack_bottom = (uint8_t*)USER_STACK - PGSIZE;
 
+    /* The stack area grows down from here in vm_stack_growth(). */
+    if (vma_create(&cur->spt, stack_bottom, (void*)USER_STACK, VM_ANON | VM_MARKER_0, true, NULL, 0, 0) == NULL)
+        return false;
+
     if (!vm_alloc_page_with_initializer(VM_ANON | VM_MARKER_0, stack_bottom, true, NULL, NULL))
         return false;
 
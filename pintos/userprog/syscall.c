@@ -20,6 +20,7 @@
 #include "userprog/validate.h"
 #ifdef VM
 #include "vm/file.h"
+#include "vm/vma.h"
 #endif
 
 void syscall_entry(void);
@@ -58,6 +59,10 @@ static int syscall_dup2(int oldfd, int newfd);
 #ifdef VM
 static void *syscall_mmap(void* addr, size_t length, int writable, int fd, off_t offset);
 static void syscall_munmap(void* addr);
+static int syscall_madvise(void* addr, size_t length, int advice);
+static int syscall_msync(void* addr, size_t length, int flags);
+static int syscall_getrusage(struct rusage* usage);
+static int syscall_setrsslimit(size_t pages);
 #endif
 
 void syscall_init(void) {
@@ -128,6 +133,18 @@ void syscall_handler(struct intr_frame* f) {
         case SYS_MUNMAP:
             syscall_munmap(arg1);
             break;
+        case SYS_MADVISE:
+            f->R.rax = syscall_madvise((void *) arg1, arg2, arg3);
+            break;
+        case SYS_MSYNC:
+            f->R.rax = syscall_msync((void *) arg1, arg2, arg3);
+            break;
+        case SYS_GETRUSAGE:
+            f->R.rax = syscall_getrusage((struct rusage *) arg1);
+            break;
+        case SYS_SETRSSLIMIT:
+            f->R.rax = syscall_setrsslimit(arg1);
+            break;
 #endif
     }
 }
@@ -205,7 +222,7 @@ static int syscall_read(int fd, void* buffer, unsigned size) {
     int result;
     if (size == 0) return 0;
 
-    if (!valid_address(buffer, true) || !valid_address(buffer + size - 1, true)) syscall_exit(-1);
+    if (!valid_buffer(buffer, size, true)) syscall_exit(-1);
     entry = get_fd_entry(thread_current(), fd);
     if (!entry || entry == stdout_entry) return -1;
 
@@ -224,7 +241,7 @@ static int syscall_write(int fd, const void* buffer, unsigned size) {
     struct file* entry;
     int result;
 
-    if (!valid_address(buffer, false) || !valid_address(buffer + size - 1, false)) syscall_exit(-1);
+    if (!valid_buffer(buffer, size, false)) syscall_exit(-1);
     entry = get_fd_entry(thread_current(), fd);
     if (!entry || entry == stdin_entry) return -1;
 
@@ -283,7 +300,11 @@ static void *syscall_mmap(void* addr, size_t length, int writable, int fd, off_t
     uintptr_t start = (uintptr_t) addr;
     uintptr_t end = start + length;
     struct file *file = get_fd_entry (thread_current (), fd);
+    bool populate = (writable & MAP_POPULATE) != 0;
+    bool shared = (writable & MAP_SHARED) != 0;
+    void *mapping;
 
+    writable &= ~(MAP_POPULATE | MAP_SHARED);
     if (addr == NULL || length == 0 || pg_ofs (addr) != 0 || offset % PGSIZE != 0)
         return NULL;
 
@@ -293,17 +314,102 @@ static void *syscall_mmap(void* addr, size_t length, int writable, int fd, off_t
     if (!is_user_vaddr (addr) || !is_user_vaddr ((void *) (end - 1)))
         return NULL;
 
-    if (file == NULL || file == stdin_entry || file == stdout_entry)
-        return NULL;
+    if (fd == MAP_ANONYMOUS) {
+        if (offset != 0)
+            return NULL;
+        mapping = do_mmap_anon (addr, length, writable, shared);
+    } else {
+        /* MAP_SHARED is for anonymous memory; files share their data already. */
+        if (shared || file == NULL || file == stdin_entry || file == stdout_entry)
+            return NULL;
+
+        lock_acquire (&file_lock);
+        file = file_reopen (file);
+        lock_release (&file_lock);
 
-    lock_acquire (&file_lock);
-    file = file_reopen (file);
-    lock_release (&file_lock);
+        mapping = file == NULL ? NULL : do_mmap (addr, length, writable, file, offset);
+    }
 
-    return file == NULL ? NULL : do_mmap (addr, length, writable, file, offset);
+    /* Read the whole mapping now in large chunks, sparing a fault per page. */
+    if (mapping != NULL && populate)
+        vm_prefetch (addr, pg_round_up ((void *) end));
+    return mapping;
 }
 
 static void syscall_munmap(void* addr) {
     do_munmap(addr);
 }
+
+/* Applies ADVICE to the pages [ADDR, ADDR + LENGTH), all of which
+ * must be mapped. Returns 0 on success, -1 on failure. */
+static int syscall_madvise(void* addr, size_t length, int advice) {
+    struct supplemental_page_table *spt = &thread_current()->spt;
+    uintptr_t start = (uintptr_t) addr;
+    uintptr_t end = start + length;
+
+    if (pg_ofs(addr) != 0 || end < start) return -1;
+    if (length == 0) return 0;
+    if (!is_user_vaddr(addr) || !is_user_vaddr((void *) (end - 1))) return -1;
+
+    end = (uintptr_t) pg_round_up((void *) end);
+    if (!vma_covers(spt, addr, (void *) end)) return -1;
+
+    switch (advice) {
+        case MADV_NORMAL:
+            vma_advise(spt, addr, (void *) end, VMA_NORMAL);
+            break;
+        case MADV_RANDOM:
+            vma_advise(spt, addr, (void *) end, VMA_RANDOM);
+            break;
+        case MADV_SEQUENTIAL:
+            vma_advise(spt, addr, (void *) end, VMA_SEQUENTIAL);
+            break;
+        case MADV_WILLNEED:
+            vm_willneed(addr, (void *) end);
+            break;
+        case MADV_DONTNEED:
+            vm_discard(addr, (void *) end);
+            break;
+        default:
+            return -1;
+    }
+    return 0;
+}
+
+/* Writes the dirty file pages in [ADDR, ADDR + LENGTH), all of which
+ * must be mapped, back to their files. FLAGS is MS_SYNC to wait for
+ * the writes or MS_ASYNC to only start them. Returns 0 on success, -1
+ * on failure. */
+static int syscall_msync(void* addr, size_t length, int flags) {
+    uintptr_t start = (uintptr_t) addr;
+    uintptr_t end = start + length;
+
+    if (pg_ofs(addr) != 0 || end < start) return -1;
+    if (flags != MS_SYNC && flags != MS_ASYNC) return -1;
+    if (length == 0) return 0;
+    if (!is_user_vaddr(addr) || !is_user_vaddr((void *) (end - 1))) return -1;
+
+    end = (uintptr_t) pg_round_up((void *) end);
+    if (!vma_covers(&thread_current()->spt, addr, (void *) end)) return -1;
+
+    return do_msync(addr, (void *) end, flags == MS_ASYNC) ? 0 : -1;
+}
+
+static int syscall_getrusage(struct rusage* usage) {
+    if (!valid_buffer(usage, sizeof *usage, true)) syscall_exit(-1);
+
+    *usage = thread_current()->rusage;
+    return 0;
+}
+
+/* Caps the frames the process may keep resident to PAGES, or lifts the
+ * cap if PAGES is 0, meaning no limit. Fails for caps below
+ * RSS_LIMIT_MIN, under which a single fault could not make progress.
+ * The cap survives exec and is inherited on fork. */
+static int syscall_setrsslimit(size_t pages) {
+    if (pages != 0 && pages < RSS_LIMIT_MIN) return -1;
+
+    thread_current()->rss_limit = pages;
+    return 0;
+}
 #endif
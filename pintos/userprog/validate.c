@@ -20,7 +20,26 @@ bool valid_address(const void* uaddr, bool write) {
         return true;
 
     page_addr = pg_round_down (uaddr);
+#ifdef VM
+    /* Copy-on-write pages are mapped read-only until the first write. */
+    struct page *page = spt_find_page (&t->spt, page_addr);
+    return page != NULL && page->writable;
+#else
     return pml4_is_writable (t->pml4, page_addr);
+#endif
+}
+
+/* Returns true if every byte of the SIZE bytes at BUFFER can be
+ * accessed as valid_address() checks. One byte per page is probed, as
+ * a page in the middle may be unmapped or read-only. */
+bool valid_buffer(const void* buffer, size_t size, bool write) {
+    const uint8_t* p = buffer;
+    const uint8_t* end = p + size;
+
+    if (end < p) return false;
+    for (; p < end; p = (const uint8_t*)pg_round_down(p) + PGSIZE)
+        if (!valid_address(p, write)) return false;
+    return true;
 }
 
 static int64_t get_user(const uint8_t* uaddr) {
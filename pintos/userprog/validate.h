@@ -2,3 +2,4 @@
 #include <stddef.h>
 
 bool valid_address(const void* uaddr, bool write);
+bool valid_buffer(const void* buffer, size_t size, bool write);
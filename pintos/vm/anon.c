@@ -1,7 +1,36 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
+#include <bitmap.h>
+#include <round.h>
+#include <string.h>
 #include "vm/vm.h"
+#include <stdio.h>
 #include "devices/disk.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/vma.h"
+
+/* Sectors making up one swap slot. */
+#define SECTORS_PER_SLOT (PGSIZE / DISK_SECTOR_SIZE)
+
+/* Compressed swap cache. Evicted pages are compressed into blocks of
+ * the kernel heap, and only the oldest of them go to swap_disk once
+ * ZSWAP_LIMIT bytes are in use. A page that does not fit a small
+ * malloc() block after compression is written to the disk directly. */
+struct zswap_entry {
+	struct list_elem elem;      /* Element of zswap_lru, oldest first. */
+	struct list pages;          /* Pages sharing it, by anon.zswap_elem. */
+	bool spilling;              /* Off zswap_lru, being written out. */
+	size_t size;                /* Bytes of DATA. */
+	uint8_t data[];
+};
+
+#define ZSWAP_LIMIT (64 * PGSIZE)
+#define ZSWAP_MAX_SIZE (1024 - sizeof (struct zswap_entry))
 
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
@@ -9,6 +38,40 @@ static bool anon_swap_in (struct page *page, void *kva);
 static bool anon_swap_out (struct page *page);
 static void anon_destroy (struct page *page);
 
+/* Swap slot allocator: one bit per page-sized slot of swap_disk, and
+ * per slot the number of pages sharing it. */
+static struct bitmap *swap_table;
+static uint16_t *slot_refs;
+static struct lock swap_lock;
+
+/* The page last written to swap_disk and its slot, under swap_lock.
+ * The page after it in the same address space takes the next slot, so
+ * that pages evicted together can be read back together. */
+static struct thread *last_owner;
+static void *last_va;
+static size_t last_slot = BITMAP_ERROR;
+
+static size_t swap_slot_alloc_locked (struct page *page);
+static void swap_slot_put_locked (size_t slot);
+static void swap_slot_free (size_t slot);
+
+/* Compressed pages and statistics, under swap_lock. */
+static struct list zswap_lru;
+static size_t zswap_bytes;
+static uint8_t zswap_buf[ZSWAP_MAX_SIZE];   /* Compressor output. */
+static uint8_t *spill_buf;                  /* Page being spilled. */
+static struct lock spill_lock;              /* Owns spill_buf. */
+static long long zswap_stores, zswap_rejects, zswap_spills;
+static long long zswap_hits, zswap_misses;
+static long long zswap_in_bytes, zswap_out_bytes;
+
+static bool zswap_store_locked (struct page *page, size_t size);
+static void zswap_make_room (void);
+static void zswap_put_locked (struct page *page);
+static void zswap_free_locked (struct zswap_entry *entry);
+static size_t lz_compress (const uint8_t *src, uint8_t *dst, size_t limit);
+static void lz_decompress (const uint8_t *src, size_t size, uint8_t *dst);
+
 /* DO NOT MODIFY this struct */
 static const struct page_operations anon_ops = {
 	.swap_in = anon_swap_in,
@@ -19,45 +82,452 @@ static const struct page_operations anon_ops = {
 
 /* Initialize the data for anonymous pages */
 void vm_anon_init (void) {
+	size_t slot_cnt = 0;
+
 	swap_disk = disk_get (1, 1);
+	if (swap_disk != NULL)
+		slot_cnt = disk_size (swap_disk) / SECTORS_PER_SLOT;
+
+	swap_table = bitmap_create (slot_cnt);
+	slot_refs = calloc (slot_cnt, sizeof *slot_refs);
+	if (swap_table == NULL || (slot_cnt > 0 && slot_refs == NULL))
+		PANIC ("swap table allocation failed");
+	lock_init (&swap_lock);
+
+	list_init (&zswap_lru);
+	lock_init (&spill_lock);
+	spill_buf = palloc_get_page (0);
+	if (spill_buf == NULL)
+		PANIC ("swap buffer allocation failed");
+}
+
+/* Prints swap statistics. */
+void
+vm_anon_print_stats (void) {
+	long long ratio = zswap_out_bytes > 0
+		? zswap_in_bytes * 100 / zswap_out_bytes : 0;
+
+	printf ("Swap: %lld compressed hits, %lld disk misses\n",
+			zswap_hits, zswap_misses);
+	printf ("Swap: %lld pages compressed (%lld.%02lld:1), %lld rejected, "
+			"%lld spilled\n", zswap_stores, ratio / 100, ratio % 100,
+			zswap_rejects, zswap_spills);
 }
 
 /* Initialize the file mapping */
-bool anon_initializer (struct page *page, enum vm_type type, void *kva) {
+bool anon_initializer (struct page *page, enum vm_type type UNUSED, void *kva) {
 	struct anon_page *anon_page;
+
+	/* Pages without a loader (stack, fresh heap) must read as zeros.
+	 * Check before the union is overwritten below. */
+	if (page->uninit.init == NULL)
+		memset (kva, 0, PGSIZE);
+
 	page->operations = &anon_ops;
-	// anon_page = &page->anon;
-	// anon_page->swap_idx = BITMAP_ERROR;
+	anon_page = &page->anon;
+	anon_page->swap_idx = BITMAP_ERROR;
+	anon_page->zswap = NULL;
 	return true;
 }
 
-/* Swap in the page by read contents from the swap disk. */
+/* Maps LENGTH bytes of zeros at ADDR as a single memory area. With
+ * SHARED, its pages stay shared with the children forked afterwards
+ * instead of being copied on write. */
+void *
+do_mmap_anon (void *addr, size_t length, bool writable, bool shared) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	void *end = addr + ROUND_UP (length, PGSIZE);
+	struct vma *vma;
+
+	vma = vma_create (spt, addr, end, VM_ANON, writable, NULL, 0, 0);
+	if (vma == NULL)
+		return NULL;
+	vma->mapped = true;
+	if (shared && !vma_share (vma)) {
+		vma_destroy (spt, vma);
+		return NULL;
+	}
+	return addr;
+}
+
+/* Swap in the page from the compressed cache or the swap disk. */
 static bool
 anon_swap_in (struct page *page, void *kva) {
+	struct anon_page *anon_page = &page->anon;
+	size_t slot;
+
 	ASSERT (page != NULL);
 	ASSERT (page->frame != NULL);
+
+	lock_acquire (&swap_lock);
+	if (anon_page->zswap != NULL) {
+		lz_decompress (anon_page->zswap->data, anon_page->zswap->size, kva);
+		zswap_put_locked (page);
+		zswap_hits++;
+		lock_release (&swap_lock);
+		return true;
+	}
+	/* A spill publishes the slot only once it is written. */
+	slot = anon_page->swap_idx;
+	if (slot != BITMAP_ERROR)
+		zswap_misses++;
+	lock_release (&swap_lock);
+
+	if (slot == BITMAP_ERROR)
+		return false;
+
+	disk_read_multiple (swap_disk, slot * SECTORS_PER_SLOT,
+			SECTORS_PER_SLOT, kva);
+	swap_slot_free (slot);
+	anon_page->swap_idx = BITMAP_ERROR;
 	return true;
 }
 
-/* Swap out the page by writing contents to the swap disk. */
+/* Swap out the page by compressing it, or failing that by writing
+ * its contents to the swap disk. Pages of read-only segments need
+ * neither. */
 static bool
 anon_swap_out (struct page *page) {
+	struct anon_page *anon_page = &page->anon;
+	void *kva = page->frame->kva;
+	size_t size;
+	size_t slot;
+
 	ASSERT (page != NULL);
+	ASSERT (page->frame != NULL);
+
+	/* Unmap first so that writes made during the transfer fault and
+	 * wait for the eviction to finish instead of being lost. */
+	pml4_clear_page (page->owner->pml4, page->va);
+
+	/* Read-only segment pages still match their file: drop them. Their
+	 * next fault turns them back into segment pages, to be reloaded
+	 * and shared again. */
+	if (page->vma != NULL && (page->vma->type & VM_TEXT))
+		return true;
+
+	zswap_make_room ();
+	lock_acquire (&swap_lock);
+	size = lz_compress (kva, zswap_buf, sizeof zswap_buf);
+	if (size > 0 && zswap_store_locked (page, size)) {
+		lock_release (&swap_lock);
+		return true;
+	}
+	zswap_rejects++;
+	slot = swap_slot_alloc_locked (page);
+	lock_release (&swap_lock);
+
+	disk_write_multiple (swap_disk, slot * SECTORS_PER_SLOT,
+			SECTORS_PER_SLOT, kva);
+	anon_page->swap_idx = slot;
 	return true;
 }
 
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void anon_destroy (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+	struct frame *frame;
 
 	ASSERT (page != NULL);
 
-	if (page->frame != NULL) {
-		struct thread *t = thread_current ();
+	frame = vm_frame_detach (page);
+	if (frame != NULL)
+		vm_frame_free (frame, page);
+
+	lock_acquire (&swap_lock);
+	if (anon_page->zswap != NULL)
+		zswap_put_locked (page);
+	if (anon_page->swap_idx != BITMAP_ERROR) {
+		swap_slot_put_locked (anon_page->swap_idx);
+		anon_page->swap_idx = BITMAP_ERROR;
+	}
+	lock_release (&swap_lock);
+}
+
+/* Takes a free swap slot for PAGE: the one after the slot of the
+ * previous page of its address space if that page was the last one
+ * swapped out, or else the first of SWAP_CLUSTER free slots in a row,
+ * leaving room for the pages that follow. Called with swap_lock
+ * held. */
+static size_t
+swap_slot_alloc_locked (struct page *page) {
+	size_t slot = BITMAP_ERROR;
+
+	if (page->owner == last_owner && page->va == last_va + PGSIZE
+			&& last_slot + 1 < bitmap_size (swap_table)
+			&& !bitmap_test (swap_table, last_slot + 1))
+		slot = last_slot + 1;
+	if (slot == BITMAP_ERROR)
+		slot = bitmap_scan (swap_table, 0, SWAP_CLUSTER, false);
+	if (slot == BITMAP_ERROR)
+		slot = bitmap_scan (swap_table, 0, 1, false);
+	if (slot == BITMAP_ERROR)
+		PANIC ("swap is full");
+
+	bitmap_mark (swap_table, slot);
+	slot_refs[slot] = 1;
+	last_owner = page->owner;
+	last_va = page->va;
+	last_slot = slot;
+	return slot;
+}
+
+/* Drops a page's reference to SLOT, returning the slot to the swap
+ * allocator with the last one. Called with swap_lock held. */
+static void
+swap_slot_put_locked (size_t slot) {
+	ASSERT (bitmap_test (swap_table, slot));
+	ASSERT (slot_refs[slot] > 0);
+
+	if (--slot_refs[slot] == 0)
+		bitmap_reset (swap_table, slot);
+}
+
+/* Drops a page's reference to SLOT. */
+static void
+swap_slot_free (size_t slot) {
+	lock_acquire (&swap_lock);
+	swap_slot_put_locked (slot);
+	lock_release (&swap_lock);
+}
+
+/* Returns the swap_disk slot holding the contents of PAGE, a swapped
+ * out anonymous page, or BITMAP_ERROR if they are elsewhere. */
+size_t
+anon_swap_slot (struct page *page) {
+	size_t slot;
+
+	lock_acquire (&swap_lock);
+	slot = page->anon.zswap == NULL ? page->anon.swap_idx : BITMAP_ERROR;
+	lock_release (&swap_lock);
+	return slot;
+}
+
+/* Reads the CNT swap slots starting at SLOT into BUF with a single
+ * transfer. */
+void
+anon_swap_read (size_t slot, size_t cnt, void *buf) {
+	ASSERT (cnt * SECTORS_PER_SLOT <= DISK_MULTIPLE_MAX);
+
+	disk_read_multiple (swap_disk, slot * SECTORS_PER_SLOT,
+			cnt * SECTORS_PER_SLOT, buf);
+}
+
+/* Frees the swap slot of PAGE, whose contents were read back with
+ * anon_swap_read(). */
+void
+anon_swap_release (struct page *page) {
+	lock_acquire (&swap_lock);
+	swap_slot_put_locked (page->anon.swap_idx);
+	page->anon.swap_idx = BITMAP_ERROR;
+	zswap_misses++;
+	lock_release (&swap_lock);
+}
+
+/* Makes DST, the copy fork made of swapped out anonymous page SRC,
+ * share the swap slot or compressed copy holding its contents, so
+ * that forking costs no swap I/O. */
+void
+anon_swap_share (struct page *src, struct page *dst) {
+	struct anon_page *anon_page = &dst->anon;
+
+	lock_acquire (&swap_lock);
+	anon_page->zswap = src->anon.zswap;
+	anon_page->swap_idx = src->anon.swap_idx;
+	if (anon_page->zswap != NULL)
+		list_push_back (&anon_page->zswap->pages, &anon_page->zswap_elem);
+	else if (anon_page->swap_idx != BITMAP_ERROR)
+		slot_refs[anon_page->swap_idx]++;
+	lock_release (&swap_lock);
+}
+
+/* Keeps the SIZE bytes in zswap_buf as the contents of PAGE. Fails if
+ * the cache is full or out of memory. Called with swap_lock held. */
+static bool
+zswap_store_locked (struct page *page, size_t size) {
+	struct zswap_entry *entry;
+
+	if (zswap_bytes + size > ZSWAP_LIMIT)
+		return false;
+	entry = malloc (sizeof *entry + size);
+	if (entry == NULL)
+		return false;
+	list_init (&entry->pages);
+	entry->spilling = false;
+	list_push_back (&entry->pages, &page->anon.zswap_elem);
+	entry->size = size;
+	memcpy (entry->data, zswap_buf, size);
+	list_push_back (&zswap_lru, &entry->elem);
+	zswap_bytes += size;
+	page->anon.zswap = entry;
+
+	zswap_stores++;
+	zswap_in_bytes += PGSIZE;
+	zswap_out_bytes += size;
+	return true;
+}
+
+/* Moves the oldest compressed pages to swap_disk until another one
+ * of any size fits, each into a slot shared by every page that shared
+ * the compressed copy. An entry is taken off zswap_lru before
+ * swap_lock is dropped for the write, and its pages keep reading the
+ * compressed copy until the slot is published. */
+static void
+zswap_make_room (void) {
+	lock_acquire (&spill_lock);
+	lock_acquire (&swap_lock);
+	while (zswap_bytes + ZSWAP_MAX_SIZE > ZSWAP_LIMIT
+			&& !list_empty (&zswap_lru)) {
+		struct zswap_entry *entry = list_entry (list_pop_front (&zswap_lru),
+				struct zswap_entry, elem);
+		size_t slot = swap_slot_alloc_locked (list_entry (list_front (&entry->pages),
+					struct page, anon.zswap_elem));
+
+		entry->spilling = true;
+		zswap_bytes -= entry->size;
+		lz_decompress (entry->data, entry->size, spill_buf);
+		lock_release (&swap_lock);
+
+		disk_write_multiple (swap_disk, slot * SECTORS_PER_SLOT,
+				SECTORS_PER_SLOT, spill_buf);
+
+		lock_acquire (&swap_lock);
+		slot_refs[slot] = list_size (&entry->pages);
+		if (slot_refs[slot] == 0)
+			bitmap_reset (swap_table, slot);
+		while (!list_empty (&entry->pages)) {
+			struct page *page = list_entry (list_pop_front (&entry->pages),
+					struct page, anon.zswap_elem);
+
+			page->anon.zswap = NULL;
+			page->anon.swap_idx = slot;
+		}
+		free (entry);
+		zswap_spills++;
+	}
+	lock_release (&swap_lock);
+	lock_release (&spill_lock);
+}
+
+/* Drops PAGE's reference to its compressed copy, freeing the copy
+ * with the last one unless it is being spilled. Called with swap_lock
+ * held. */
+static void
+zswap_put_locked (struct page *page) {
+	struct zswap_entry *entry = page->anon.zswap;
+
+	list_remove (&page->anon.zswap_elem);
+	page->anon.zswap = NULL;
+	if (list_empty (&entry->pages) && !entry->spilling)
+		zswap_free_locked (entry);
+}
+
+static void
+zswap_free_locked (struct zswap_entry *entry) {
+	list_remove (&entry->elem);
+	zswap_bytes -= entry->size;
+	free (entry);
+}
+
+/* A small LZ77 compressor for pages. The output is a sequence of
+ * literal runs, a byte N < 0x80 followed by N + 1 bytes, and matches,
+ * a byte 0x80 | (LENGTH - LZ_MIN_MATCH) followed by the 16-bit
+ * little-endian distance back to the copied bytes. */
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_MATCH (LZ_MIN_MATCH + 0x7f)
+#define LZ_MAX_LITERALS 0x80
+#define LZ_HASH_BITS 10
+
+static uint16_t lz_table[1 << LZ_HASH_BITS];
+
+static uint32_t
+lz_load (const uint8_t *p) {
+	uint32_t v;
+
+	memcpy (&v, p, sizeof v);
+	return v;
+}
+
+/* Appends the CNT bytes at SRC to DST as literal runs. */
+static bool
+lz_literals (uint8_t *dst, size_t *op, size_t limit, const uint8_t *src,
+		size_t cnt) {
+	while (cnt > 0) {
+		size_t run = cnt < LZ_MAX_LITERALS ? cnt : LZ_MAX_LITERALS;
+
+		if (*op + 1 + run > limit)
+			return false;
+		dst[(*op)++] = run - 1;
+		memcpy (dst + *op, src, run);
+		*op += run;
+		src += run;
+		cnt -= run;
+	}
+	return true;
+}
+
+/* Compresses the page at SRC into DST. Returns the compressed size,
+ * or 0 if it would exceed LIMIT bytes. Called with swap_lock held,
+ * which covers lz_table. */
+static size_t
+lz_compress (const uint8_t *src, uint8_t *dst, size_t limit) {
+	size_t ip = 0, lit = 0, op = 0;
+
+	memset (lz_table, 0, sizeof lz_table);
+	while (ip + LZ_MIN_MATCH <= PGSIZE) {
+		uint32_t seq = lz_load (src + ip);
+		size_t hash = (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+		size_t cand = lz_table[hash];
+		size_t len, dist;
+
+		lz_table[hash] = ip;
+		if (cand >= ip || lz_load (src + cand) != seq) {
+			ip++;
+			continue;
+		}
+
+		len = LZ_MIN_MATCH;
+		while (ip + len < PGSIZE && len < LZ_MAX_MATCH
+				&& src[cand + len] == src[ip + len])
+			len++;
+		if (!lz_literals (dst, &op, limit, src + lit, ip - lit)
+				|| op + 3 > limit)
+			return 0;
+		dist = ip - cand;
+		dst[op++] = 0x80 | (len - LZ_MIN_MATCH);
+		dst[op++] = dist & 0xff;
+		dst[op++] = dist >> 8;
+		ip += len;
+		lit = ip;
+	}
+	if (!lz_literals (dst, &op, limit, src + lit, PGSIZE - lit))
+		return 0;
+	return op;
+}
+
+/* Expands the SIZE bytes at SRC, made by lz_compress(), into the page
+ * at DST. */
+static void
+lz_decompress (const uint8_t *src, size_t size, uint8_t *dst) {
+	const uint8_t *end = src + size;
+	size_t op = 0;
+
+	while (src < end) {
+		uint8_t c = *src++;
+
+		if (c & 0x80) {
+			size_t len = (c & 0x7f) + LZ_MIN_MATCH;
+			size_t dist = src[0] | (src[1] << 8);
 
-		pml4_clear_page (t->pml4, page->va);
-		palloc_free_page (page->frame->kva);
-		free (page->frame);
-		page->frame = NULL;
+			/* Byte by byte, as the copy may overlap its source. */
+			src += 2;
+			for (; len > 0; len--, op++)
+				dst[op] = dst[op - dist];
+		} else {
+			memcpy (dst + op, src, c + 1);
+			src += c + 1;
+			op += c + 1;
+		}
 	}
+	ASSERT (op == PGSIZE);
 }
@@ -5,17 +5,43 @@
 #include "threads/malloc.h"
 #include "threads/mmu.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "vm/vm.h"
 #include "vm/file.h"
+#include "vm/vma.h"
 #include "userprog/syscall.h"
 
 static bool file_backed_swap_in (struct page *page, void *kva);
 static bool file_backed_swap_out (struct page *page);
 static void file_backed_destroy (struct page *page);
 bool lazy_load_file (struct page *page, void *aux);
-static struct mmap_file *find_mmap (struct thread *t, void *addr);
+
+/* Most pages written back by one file_write_at(). */
+#define WRITEBACK_MAX 32
+
+/* A write queued by msync(MS_ASYNC) for writeback_thread: a copy of
+ * PAGE_CNT contiguous pages, to be written to FILE at OFS. Until it is
+ * done its pages are marked writeback_pending and are not written
+ * back any other way, so that writes reach the file in order. */
+struct writeback {
+	struct list_elem elem;
+	struct file *file;          /* Reopened; closed once written. */
+	off_t ofs;
+	size_t size;                /* Bytes to write from BUF. */
+	uint8_t *buf;               /* PAGE_CNT pages. */
+	size_t page_cnt;
+	struct page *pages[WRITEBACK_MAX];
+};
+
+static struct list writeback_queue;
+static struct lock writeback_lock;
+static struct condition writeback_done;
+static struct semaphore writeback_sema;
+
+static void writeback_thread (void *aux);
+static void writeback_wait (struct page *page);
 
 /* DO NOT MODIFY this struct */
 static const struct page_operations file_ops = {
@@ -28,6 +54,12 @@ static const struct page_operations file_ops = {
 /* The initializer of file vm */
 void
 vm_file_init (void) {
+	list_init (&writeback_queue);
+	lock_init (&writeback_lock);
+	cond_init (&writeback_done);
+	sema_init (&writeback_sema, 0);
+	if (thread_create ("writeback", PRI_DEFAULT, writeback_thread, NULL) == TID_ERROR)
+		PANIC ("cannot start writeback thread");
 }
 /* Initialize the file backed page */
 bool file_backed_initializer (struct page *page, enum vm_type type, void *kva) {
@@ -40,6 +72,7 @@ static bool file_backed_swap_in (struct page *page, void *kva) {
 	struct file_page *file_page = &page->file;
 	off_t ofs;
 	size_t page_read_bytes;
+	bool held;
 
 	ASSERT (page != NULL);
 	ASSERT (kva != NULL);
@@ -47,9 +80,13 @@ static bool file_backed_swap_in (struct page *page, void *kva) {
 	ofs = file_page->ofs;
 	page_read_bytes = file_page->read_bytes;
 
-	lock_acquire (&file_lock);
+	/* The fault may come from read()/write() touching a mapped buffer. */
+	held = lock_held_by_current_thread (&file_lock);
+	if (!held)
+		lock_acquire (&file_lock);
 	off_t bytes_read = file_read_at (file_page->file, kva, page_read_bytes, ofs);
-	lock_release (&file_lock);
+	if (!held)
+		lock_release (&file_lock);
 
 	if (bytes_read != (off_t) page_read_bytes)
 		return false;
@@ -58,89 +95,98 @@ static bool file_backed_swap_in (struct page *page, void *kva) {
 	return true;
 }
 
-/* Swap out the page by writeback contents to the file. */
-static bool file_backed_swap_out (struct page *page) {
-	struct frame *frame = page->frame;
-	struct thread *t = thread_current ();
+/* Writes PAGE back to its file if the process dirtied it.
+ * The caller holds file_lock and has already unmapped PAGE. */
+static void file_backed_writeback (struct page *page, void *kva) {
 	struct file_page *file_page = &page->file;
 
-	if (frame == NULL)
-		return true;
+	if (file_page->read_bytes > 0 && vm_page_is_dirty (page)) {
+		file_write_at (file_page->file, kva, file_page->read_bytes, file_page->ofs);
+		vm_page_clear_dirty (page);
+	}
+}
 
-	if (file_page->read_bytes > 0 && pml4_is_dirty (t->pml4, page->va)) {
-		lock_acquire (&file_lock);
-		file_write_at (file_page->file, frame->kva, file_page->read_bytes, file_page->ofs);
+/* Swap out the page by writeback contents to the file.
+ * Runs in the evictor, often reclaimd. A thread that holds file_lock
+ * may itself be waiting for reclaimd to free a frame, so never block
+ * on it: refuse instead and let the clock pick another victim. */
+static bool file_backed_swap_out (struct page *page) {
+	bool held = lock_held_by_current_thread (&file_lock);
+
+	/* Reloading it before the queued write lands would read stale data. */
+	if (page->file.writeback_pending)
+		return false;
+	if (!held && !lock_try_acquire (&file_lock))
+		return false;
+
+	pml4_clear_page (page->owner->pml4, page->va);
+	file_backed_writeback (page, page->frame->kva);
+
+	if (!held)
 		lock_release (&file_lock);
-	}
+	return true;
+}
+
+/* Writes PAGE back to its file ahead of eviction if the process
+ * dirtied it, leaving it mapped. The dirty bit is cleared before the
+ * copy, so a write racing with it marks the page dirty again. Called
+ * by reclaimd, so like file_backed_swap_out() it does not wait for
+ * file_lock but returns false if it is busy. */
+bool file_backed_clean (struct page *page) {
+	struct file_page *file_page = &page->file;
+
+	if (file_page->read_bytes == 0 || file_page->writeback_pending
+			|| !vm_page_is_dirty (page))
+		return true;
+	if (!lock_try_acquire (&file_lock))
+		return false;
 
-	pml4_clear_page (t->pml4, page->va);
-	// palloc_free_page (frame->kva);
-	// free (frame);
-	page->frame = NULL;
+	vm_page_clear_dirty (page);
+	file_write_at (file_page->file, page->frame->kva, file_page->read_bytes, file_page->ofs);
+	lock_release (&file_lock);
 	return true;
 }
 
 /* Destory the file backed page. PAGE will be freed by the caller. */
 static void file_backed_destroy (struct page *page) {
-	file_backed_swap_out (page);
+	struct frame *frame = vm_frame_detach (page);
+	bool held;
+
+	if (frame == NULL)
+		return;
+
+	writeback_wait (page);
+	held = lock_held_by_current_thread (&file_lock);
+	if (!held)
+		lock_acquire (&file_lock);
+	file_backed_writeback (page, frame->kva);
+	if (!held)
+		lock_release (&file_lock);
+
+	vm_frame_free (frame, page);
 }
 
+/* Maps LENGTH bytes of FILE starting at OFFSET to ADDR as a single
+ * memory area; pages are only created as they are touched. Takes
+ * ownership of FILE. */
 void *do_mmap (void *addr, size_t length, int writable, struct file *file, off_t offset) {
 	struct thread *t = thread_current ();
-	size_t page_cnt = DIV_ROUND_UP (length, PGSIZE);
-	void *upage = addr;
-	struct mmap_file *map;
+	void *end = addr + ROUND_UP (length, PGSIZE);
 	off_t file_len = file_length (file);
+	size_t read_bytes = 0;
+	struct vma *vma;
 
-	for (size_t i = 0; i < page_cnt; i++, upage += PGSIZE) {
-		if (spt_find_page (&t->spt, upage) != NULL)
-			goto fail_file;
+	if (offset < file_len) {
+		size_t file_left = file_len - offset;
+		read_bytes = file_left < (size_t) (end - addr) ? file_left : (size_t) (end - addr);
 	}
 
-	map = calloc (1, sizeof *map);
-
-	if (map == NULL)
+	vma = vma_create (&t->spt, addr, end, VM_FILE, writable, file, offset, read_bytes);
+	if (vma == NULL)
 		goto fail_file;
-
-	map->start = addr;
-	map->page_cnt = page_cnt;
-	map->file = file;
-	map->offset = offset;
-	list_push_back (&t->mmap_list, &map->elem);
-
-	upage = addr;
-	for (size_t i = 0; i < page_cnt; i++, upage += PGSIZE) {
-		off_t cur_ofs = offset + i * PGSIZE;
-		size_t read_bytes = 0;
-
-		if (cur_ofs < file_len) {
-			size_t file_left = file_len - cur_ofs;
-			read_bytes = file_left >= PGSIZE ? PGSIZE : file_left;
-		}
-		
-		size_t zero_bytes = PGSIZE - read_bytes;
-		struct file_page *aux = malloc (sizeof *aux);
-
-		if (aux == NULL)
-			goto fail_map;
-
-		aux->file = file;
-		aux->ofs = offset + i * PGSIZE;
-		aux->read_bytes = read_bytes;
-		aux->zero_bytes = zero_bytes;
-		aux->mmap = map;
-
-		if (!vm_alloc_page_with_initializer (VM_FILE, upage, writable, lazy_load_file, aux)) {
-			free (aux);
-			goto fail_map;
-		}
-	}
+	vma->mapped = true;
 	return addr;
 
-fail_map:
-	do_munmap (addr);
-	return NULL;
-
 fail_file:
 	lock_acquire (&file_lock);
 	file_close (file);
@@ -148,34 +194,223 @@ fail_file:
 	return NULL;
 }
 
-
 /* Do the munmap */
 void do_munmap (void *addr) {
 	struct thread *t = thread_current ();
-	struct mmap_file *target;
+	struct vma *vma;
 
 	if (addr == NULL)
 		return;
 
-	target = find_mmap (t, addr);
-	if (target == NULL)
+	vma = vma_find (&t->spt, addr);
+	if (vma == NULL || vma->start != addr || !vma->mapped)
 		return;
 
-	void *upage = target->start;
-	for (size_t i = 0; i < target->page_cnt; i++, upage += PGSIZE) {
-		struct page *page = spt_find_page (&t->spt, upage);
+	vma_destroy (&t->spt, vma);
+}
+
+/* Writes SIZE bytes from BUF to FILE at OFS. */
+static bool
+writeback_write (struct file *file, const void *buf, size_t size, off_t ofs) {
+	bool held = lock_held_by_current_thread (&file_lock);
+	bool success;
+
+	if (!held)
+		lock_acquire (&file_lock);
+	success = file_write_at (file, buf, size, ofs) == (off_t) size;
+	if (!held)
+		lock_release (&file_lock);
+	return success;
+}
+
+/* Waits until the queued write of PAGE, if any, is done. */
+static void
+writeback_wait (struct page *page) {
+	lock_acquire (&writeback_lock);
+	while (page->file.writeback_pending)
+		cond_wait (&writeback_done, &writeback_lock);
+	lock_release (&writeback_lock);
+}
+
+/* Pins the frame of PAGE if it is a resident file page that its
+ * process dirtied, once an earlier queued write of it is done. */
+static bool
+writeback_pin (struct page *page) {
+	if (page == NULL || VM_TYPE (page->operations->type) != VM_FILE
+			|| page->file.read_bytes == 0)
+		return false;
+
+	writeback_wait (page);
+	if (vm_pin_page (page, false) == NULL)
+		return false;
+	if (!vm_page_is_dirty (page)) {
+		vm_unpin_frame (page->frame);
+		return false;
+	}
+	return true;
+}
 
-		if (page == NULL)
-			continue;
+/* Writes back the CNT pinned, dirty pages of RUN, which follow each
+ * other in the same file, with one write, and unpins them. With ASYNC
+ * the write is left to writeback_thread. Falls back to writing page
+ * by page if memory is short. */
+static bool
+writeback_run (struct page **run, size_t cnt, bool async) {
+	struct file_page *first = &run[0]->file;
+	size_t size = (cnt - 1) * PGSIZE + run[cnt - 1]->file.read_bytes;
+	struct writeback *wb = NULL;
+	bool success = true;
+	uint8_t *buf;
+
+	buf = palloc_get_multiple (0, cnt);
+	if (async && buf != NULL && (wb = malloc (sizeof *wb)) != NULL) {
+		bool held = lock_held_by_current_thread (&file_lock);
+
+		if (!held)
+			lock_acquire (&file_lock);
+		wb->file = file_reopen (first->file);
+		if (!held)
+			lock_release (&file_lock);
+		if (wb->file == NULL) {
+			free (wb);
+			wb = NULL;
+		}
+	}
 
-		spt_remove_page (&t->spt, page);
+	for (size_t i = 0; i < cnt; i++) {
+		struct page *page = run[i];
+		struct frame *frame = page->frame;
+
+		vm_page_clear_dirty (page);
+		if (buf != NULL)
+			memcpy (buf + i * PGSIZE, frame->kva, PGSIZE);
+		else if (!writeback_write (page->file.file, frame->kva,
+					page->file.read_bytes, page->file.ofs))
+			success = false;
+
+		if (wb != NULL) {
+			lock_acquire (&writeback_lock);
+			page->file.writeback_pending = true;
+			lock_release (&writeback_lock);
+			wb->pages[i] = page;
+		}
+		vm_unpin_frame (frame);
 	}
 
-	lock_acquire (&file_lock);
-	file_close (target->file);
-	lock_release (&file_lock);
-	list_remove (&target->elem);
-	free (target);
+	if (wb != NULL) {
+		wb->ofs = first->ofs;
+		wb->size = size;
+		wb->buf = buf;
+		wb->page_cnt = cnt;
+		lock_acquire (&writeback_lock);
+		list_push_back (&writeback_queue, &wb->elem);
+		lock_release (&writeback_lock);
+		sema_up (&writeback_sema);
+	} else if (buf != NULL) {
+		success = writeback_write (first->file, buf, size, first->ofs);
+		palloc_free_multiple (buf, cnt);
+	}
+	return success;
+}
+
+/* Visits PAGE, which may be NULL, in address order for msync: adds
+ * it to the run of contiguous dirty pages in RUN, first writing the
+ * run out if PAGE does not extend it. A run ends at a clean or missing
+ * page, at the end of its area, or once it is WRITEBACK_MAX pages
+ * long. Returns false if a write failed. */
+static bool
+msync_visit (struct page **run, size_t *run_cnt, struct page *page,
+		bool async) {
+	bool dirty = writeback_pin (page);
+	bool success = true;
+
+	if (*run_cnt > 0 && (!dirty || page->vma != run[0]->vma
+				|| page->va != run[*run_cnt - 1]->va + PGSIZE
+				|| *run_cnt == WRITEBACK_MAX)) {
+		success = writeback_run (run, *run_cnt, async);
+		*run_cnt = 0;
+	}
+	if (dirty)
+		run[(*run_cnt)++] = page;
+	return success;
+}
+
+/* Writes back the dirty file pages in [ADDR, END) of the current
+ * address space. Pages are visited in address order, which within an
+ * area is file order, and each run of contiguous dirty pages goes out
+ * with one write of up to WRITEBACK_MAX pages. With ASYNC the runs
+ * are copied and queued for writeback_thread instead. Returns false
+ * if a write failed. */
+bool
+do_msync (void *addr, void *end, bool async) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct page *run[WRITEBACK_MAX];
+	size_t run_cnt = 0;
+	bool success = true;
+
+	for (uint8_t *va = addr; va < (uint8_t *) end; va += PGSIZE)
+		if (!msync_visit (run, &run_cnt, spt_find_page (spt, va), async))
+			success = false;
+	if (run_cnt > 0 && !writeback_run (run, run_cnt, async))
+		success = false;
+	return success;
+}
+
+static bool
+page_va_less (const struct list_elem *a, const struct list_elem *b,
+		void *aux UNUSED) {
+	return list_entry (a, struct page, vma_elem)->va
+		< list_entry (b, struct page, vma_elem)->va;
+}
+
+/* Writes back, synchronously, the dirty pages of file mapping VMA of
+ * the current address space, like do_msync() over the whole area.
+ * Only the pages the area has materialized are visited, so the cost
+ * follows its resident pages rather than its size. */
+bool
+do_msync_area (struct vma *vma) {
+	struct page *run[WRITEBACK_MAX];
+	size_t run_cnt = 0;
+	bool success = true;
+	struct list_elem *e;
+
+	/* Pages join the list in the order they are touched. */
+	list_sort (&vma->pages, page_va_less, NULL);
+	for (e = list_begin (&vma->pages); e != list_end (&vma->pages);
+			e = list_next (e))
+		if (!msync_visit (run, &run_cnt,
+					list_entry (e, struct page, vma_elem), false))
+			success = false;
+	if (run_cnt > 0 && !writeback_run (run, run_cnt, false))
+		success = false;
+	return success;
+}
+
+/* Performs the writes queued by msync(MS_ASYNC). */
+static void
+writeback_thread (void *aux UNUSED) {
+	for (;;) {
+		struct writeback *wb;
+
+		sema_down (&writeback_sema);
+		lock_acquire (&writeback_lock);
+		wb = list_entry (list_pop_front (&writeback_queue), struct writeback, elem);
+		lock_release (&writeback_lock);
+
+		lock_acquire (&file_lock);
+		file_write_at (wb->file, wb->buf, wb->size, wb->ofs);
+		file_close (wb->file);
+		lock_release (&file_lock);
+
+		lock_acquire (&writeback_lock);
+		for (size_t i = 0; i < wb->page_cnt; i++)
+			wb->pages[i]->file.writeback_pending = false;
+		cond_broadcast (&writeback_done, &writeback_lock);
+		lock_release (&writeback_lock);
+
+		palloc_free_multiple (wb->buf, wb->page_cnt);
+		free (wb);
+	}
 }
 
 bool lazy_load_file (struct page *page, void *aux) {
@@ -186,18 +421,6 @@ bool lazy_load_file (struct page *page, void *aux) {
 	ASSERT (page->frame != NULL);
 
 	*dst = *src;
-	free (src);
+	slab_free (src);
 	return file_backed_swap_in (page, page->frame->kva);
 }
-
-static struct mmap_file *find_mmap (struct thread *t, void *addr) {
-	struct list_elem *e = list_begin (&t->mmap_list);
-
-	while (e != list_end (&t->mmap_list)) {
-		struct mmap_file *map = list_entry (e, struct mmap_file, elem);
-		if (map->start == addr)
-			return map;
-		e = list_next (e);
-	}
-	return NULL;
-}
@@ -10,7 +10,8 @@
 
 #include "vm/vm.h"
 #include "vm/uninit.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
+#include "vm/vma.h"
 #include "filesys/file.h"
 #include "userprog/process.h"
 
@@ -45,6 +46,23 @@ uninit_new (struct page *page, void *va, vm_initializer *init,
 	};
 }
 
+/* Turns PAGE, which was loaded before, back into a page that INIT
+ * with AUX loads on its next fault. Unlike uninit_new(), keeps the
+ * members of PAGE outside of the per-type union. */
+void
+uninit_reset (struct page *page, vm_initializer *init, enum vm_type type,
+		void *aux, bool (*initializer)(struct page *, enum vm_type, void *)) {
+	ASSERT (page != NULL);
+
+	page->operations = &uninit_ops;
+	page->uninit = (struct uninit_page) {
+		.init = init,
+		.type = type,
+		.aux = aux,
+		.page_initializer = initializer,
+	};
+}
+
 /* Initalize the page on first fault */
 static bool uninit_initialize (struct page *page, void *kva) {
 	struct uninit_page *uninit;
@@ -69,24 +87,25 @@ static bool uninit_initialize (struct page *page, void *kva) {
 	struct uninit_page *uninit = &page->uninit;
 	void *aux = uninit->aux;
 
+	/* A page that was only ever read may still map the zero page,
+	 * which pml4_destroy() must not free. */
+	vm_zero_unmap (page);
+
 	if (aux == NULL)
 		return;
 
 	switch (VM_TYPE (uninit->type)) {
 		
 	case VM_ANON:
-		lazy_load_info *info = aux;
-		if (info->file != NULL)
-			file_close (info->file);
-		free (info);
+		segment_put (aux);
 		break;
 
 	case VM_FILE:
-		free (aux);
+		slab_free (aux);
 		break;
 
 	default:
-		free (aux);
+		slab_free (aux);
 		break;
 	}
 
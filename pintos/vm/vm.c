@@ -9,7 +9,113 @@
 #include "vm/vm.h"
 #include "vm/inspect.h"
 #include "filesys/file.h"
+#include "filesys/inode.h"
+#include "userprog/syscall.h"
 #include "vm/file.h"
+#include "vm/vma.h"
+
+/* Pages loaded per file-backed fault; 1 disables fault-around.
+ * Set with the -fa option. */
+size_t vm_fault_around = 8;
+
+/* Print each process's paging statistics when it exits. Set with the
+ * -rusage option. */
+bool vm_print_rusage;
+
+struct slab_cache page_slab;
+struct slab_cache segment_cache;
+struct slab_cache file_aux_cache;
+
+/* Global frame table covering the whole user pool. */
+static struct frame *frame_table;
+static size_t frame_cnt;
+static void *frame_base;
+static size_t clock_hand;
+static struct lock frame_lock;
+
+/* System-wide cache of frames holding read-only ELF segment pages,
+ * keyed by the file contents they were loaded from. Every process
+ * running the same binary maps the cached frame instead of reading
+ * its own copy. Protected by frame_lock. */
+struct text_entry {
+	struct hash_elem elem;
+	struct inode *inode;        /* Reference held while cached. */
+	off_t ofs;
+	size_t read_bytes;
+	struct frame *frame;
+	struct list_elem reap_elem; /* Waiting for its inode to be closed. */
+};
+static struct hash text_cache;
+static struct list text_reap_list;
+
+/* Background reclaim: once fewer than vm_reclaim_low frames of the
+ * user pool are free, reclaimd evicts until vm_reclaim_high are, so
+ * that page faults rarely have to evict themselves. 0 picks a default
+ * from the pool size. Set with the -reclaim-low/-reclaim-high options. */
+size_t vm_reclaim_low;
+size_t vm_reclaim_high;
+static struct semaphore reclaim_sema;
+static bool reclaim_running;        /* reclaimd was woken up. */
+static bool reclaim_stuck;          /* Its last run ran out of victims. */
+static struct condition frame_freed;
+
+/* Signaled when a frame stops being busy. */
+static struct condition frame_idle;
+
+/* Frames past the clock hand that reclaimd writes back ahead of time. */
+#define RECLAIM_CLEAN_CNT 16
+
+/* MADV_WILLNEED: prefetchd reads the contents of pages that are not
+ * resident into frames of their own in the background. The owner maps
+ * such a frame on its first fault on the page, waiting for the read if
+ * it is in progress; a request prefetchd has not started yet is
+ * dropped and the page loaded as usual. At most PREFETCH_MAX pages of
+ * a process wait to be mapped. Only the owner adds requests to its
+ * spt->prefetches or removes them; prefetch_lock protects the queue
+ * and the state of each request. */
+#define PREFETCH_MAX 64
+
+enum prefetch_state {
+	PREFETCH_QUEUED,
+	PREFETCH_READING,
+	PREFETCH_DONE,
+};
+
+struct prefetch {
+	struct list_elem elem;        /* In the owner's spt->prefetches. */
+	struct list_elem queue_elem;  /* In prefetch_queue while queued. */
+	void *va;
+	struct frame *frame;          /* Pinned, mapped by nobody yet. */
+	struct file *file;            /* Reopened, or NULL to read SLOT. */
+	off_t ofs;
+	size_t read_bytes;
+	size_t slot;
+	enum prefetch_state state;
+	bool loaded;                  /* The read succeeded. */
+};
+static struct list prefetch_queue;
+static struct lock prefetch_lock;
+static struct condition prefetch_done;
+static struct semaphore prefetch_sema;
+
+/* Kernel page of zeros, mapped read-only for reads of anonymous pages
+ * that were never written. Not part of the frame table. */
+static void *zero_page;
+
+static void frame_table_init (void);
+static void reclaim_init (void);
+static void reclaim_wake_locked (void);
+static uint64_t text_hash (const struct hash_elem *e, void *aux);
+static bool text_less (const struct hash_elem *a, const struct hash_elem *b, void *aux);
+static void text_cache_publish (struct page *page, const struct text_entry *key);
+static void text_cache_remove_locked (struct frame *frame);
+static void text_cache_reap (void);
+static bool text_cache_contains (struct page *page);
+static void prefetch_init (void);
+static bool prefetch_claim (struct page *page);
+static void prefetch_cancel (struct page *page);
+static struct prefetch *prefetch_find (struct page *page);
+
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
 void
@@ -21,7 +127,49 @@ vm_init (void) {
 #endif
 	register_inspect_intr ();
 	/* DO NOT MODIFY UPPER LINES. */
-	/* TODO: Your code goes here. */
+	slab_cache_init (&page_slab, "page", sizeof (struct page));
+	slab_cache_init (&segment_cache, "segment", sizeof (struct segment));
+	slab_cache_init (&file_aux_cache, "file_aux", sizeof (struct file_page));
+	frame_table_init ();
+
+	zero_page = palloc_get_page (PAL_ZERO);
+	if (zero_page == NULL)
+		PANIC ("zero page allocation failed");
+
+	reclaim_init ();
+	prefetch_init ();
+}
+
+/* Allocates one struct frame per page of the user pool. Frames are
+ * never created or freed afterwards; claiming a page only links it to
+ * the entry that matches the kva handed out by palloc. */
+static void
+frame_table_init (void) {
+	palloc_user_pool_range (&frame_base, &frame_cnt);
+	frame_table = calloc (frame_cnt, sizeof *frame_table);
+	if (frame_table == NULL)
+		PANIC ("frame table allocation failed");
+
+	for (size_t i = 0; i < frame_cnt; i++) {
+		frame_table[i].kva = frame_base + i * PGSIZE;
+		list_init (&frame_table[i].rmap);
+	}
+
+	lock_init (&frame_lock);
+	cond_init (&frame_idle);
+	clock_hand = 0;
+
+	hash_init (&text_cache, text_hash, text_less, NULL);
+	list_init (&text_reap_list);
+}
+
+/* Returns the frame table entry of user pool page KVA. */
+static struct frame *
+frame_lookup (void *kva) {
+	size_t idx = pg_no (kva) - pg_no (frame_base);
+
+	ASSERT (idx < frame_cnt);
+	return &frame_table[idx];
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -39,15 +187,33 @@ page_get_type (struct page *page) {
 }
 
 /* Helpers */
-static struct frame *vm_get_victim (void);
+static struct frame *vm_get_victim (struct thread *owner);
 static bool vm_do_claim_page (struct page *page);
-static struct frame *vm_evict_frame (void);
+static void page_reload_text (struct page *page);
+static void rusage_count_load (struct page *page, enum vm_type type);
+static bool page_settle (struct page *page);
+static bool vm_claim_frame (struct page *page);
+static bool vm_claim_text_page (struct page *page);
+static bool vm_claim_shared_page (struct page *page);
+static bool vm_claim_around (struct page *page, size_t window);
+static size_t fault_around_window (struct page *page);
+static bool vm_swap_in_around (struct page *page, size_t window);
+static size_t swap_readahead_window (struct page *page);
+static bool page_is_zero_fill (struct page *page);
+static bool vm_map_zero_page (struct page *page);
+static void vm_finish_uninit (struct page *page, void *kva);
+static bool lazy_file_range (struct page *page, struct file **file, off_t *ofs,
+		size_t *read_bytes);
+static bool vm_claim_huge (struct supplemental_page_table *spt, void *va);
+static bool vm_huge_split_locked (struct frame *frame);
+static struct frame *vm_evict_frame (struct thread *owner);
 static uint64_t page_hash (const struct hash_elem *e, void *aux);
 static bool page_less (const struct hash_elem *a, const struct hash_elem *b, void *aux);
 static bool should_grow_stack (struct intr_frame *f, void *addr, bool user);
 static bool vm_stack_growth (void *addr);
 static void spt_destroy_page (struct hash_elem *elem, void *aux);
 static bool copy_uninit_page (struct supplemental_page_table *dst, struct page *src_page);
+static bool copy_swapped_page (struct supplemental_page_table *dst, struct page *src_page);
 static bool copy_anon_page (struct supplemental_page_table *dst, struct page *src_page);
 static bool copy_file_page(struct supplemental_page_table *dst_spt, struct page *src_page);
 
@@ -60,7 +226,7 @@ bool vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writab
 	struct supplemental_page_table *spt = &thread_current ()->spt;
 
 	if (spt_find_page (spt, upage) == NULL) {
-		struct page *page = malloc (sizeof *page);
+		struct page *page = slab_alloc (&page_slab);
 		bool (*initializer) (struct page *, enum vm_type, void *) = NULL;
 
 		if (page == NULL) 
@@ -74,15 +240,16 @@ bool vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writab
 				initializer = file_backed_initializer;
 				break;
 			default:
-				free (page);
+				slab_free (page);
 				goto err;
 		}
 
 		uninit_new (page, upage, init, type, aux, initializer);
 		page->writable = writable;
+		page->owner = thread_current ();
 
 		if (!spt_insert_page (spt, page)) {
-			free (page);
+			slab_free (page);
 			goto err;
 		}
 		return true;
@@ -115,7 +282,25 @@ bool spt_insert_page (struct supplemental_page_table *spt, struct page *page) {
 		return false;
 
 	// page->va = pg_round_down (page->va);
-	return hash_insert (&spt->hash_table, &page->hash_elem) == NULL;
+	if (hash_insert (&spt->hash_table, &page->hash_elem) != NULL)
+		return false;
+
+	page->vma = vma_find (spt, page->va);
+	if (page->vma != NULL)
+		list_push_back (&page->vma->pages, &page->vma_elem);
+	return true;
+}
+
+/* Returns the page at VA, creating it from the memory area VA lies in
+ * if it has not been touched yet. */
+static struct page *
+spt_lookup_page (struct supplemental_page_table *spt, void *va) {
+	struct page *page = spt_find_page (spt, va);
+	struct vma *vma;
+
+	if (page == NULL && (vma = vma_find (spt, va)) != NULL)
+		page = vma_materialize (vma, pg_round_down (va));
+	return page;
 }
 
 bool spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
@@ -127,73 +312,529 @@ bool spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
 	result = hash_delete(&spt->hash_table, &page->hash_elem);
 
 	if (result != NULL) {
+		if (page->vma != NULL)
+			list_remove (&page->vma_elem);
 		vm_dealloc_page (page);
 		return true;
 	}
 	return false;
 }
 
-/* Get the struct frame, that will be evicted. */
-static struct frame *
-vm_get_victim (void) {
-	struct frame *victim = NULL;
-	 /* TODO: The policy for eviction is up to you. */
+/* Makes PAGE one of the pages mapping FRAME, which counts towards the
+ * resident set of its process. Called with frame_lock held. */
+static void
+rmap_add (struct frame *frame, struct page *page) {
+	page->frame = frame;
+	list_push_back (&frame->rmap, &page->rmap_elem);
+	page->owner->rss++;
+}
 
-	return victim;
+/* Undoes rmap_add(). Called with frame_lock held. */
+static void
+rmap_remove (struct frame *frame, struct page *page) {
+	ASSERT (page->frame == frame);
+
+	list_remove (&page->rmap_elem);
+	page->frame = NULL;
+	page->owner->rss--;
 }
 
-/* Evict one page and return the corresponding frame.
- * Return NULL on error.*/
-static struct frame *
-vm_evict_frame (void) {
-	struct frame *victim UNUSED = vm_get_victim ();
-	/* TODO: swap out the victim and return the evicted frame. */
+/* Returns true if any page mapping FRAME was accessed since the last
+ * call, clearing the accessed bits of all of them. Accesses to pages
+ * of sequentially read areas do not count, as those are used once.
+ * Called with frame_lock held. */
+static bool
+rmap_test_and_clear_accessed (struct frame *frame) {
+	bool accessed = false;
+	struct list_elem *e;
+
+	for (e = list_begin (&frame->rmap); e != list_end (&frame->rmap);
+			e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, rmap_elem);
+
+		if (!pml4_is_accessed (page->owner->pml4, page->va))
+			continue;
+		pml4_set_accessed (page->owner->pml4, page->va, false);
+		if (page->vma == NULL || page->vma->advice != VMA_SEQUENTIAL)
+			accessed = true;
+	}
+	return accessed;
+}
+
+/* Returns true if FRAME was written through any page mapping it.
+ * With CLEAR, also clears their dirty bits. Called with frame_lock
+ * held. */
+static bool
+rmap_test_dirty (struct frame *frame, bool clear) {
+	bool dirty = false;
+	struct list_elem *e;
+
+	for (e = list_begin (&frame->rmap); e != list_end (&frame->rmap);
+			e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, rmap_elem);
+
+		if (!pml4_is_dirty (page->owner->pml4, page->va))
+			continue;
+		dirty = true;
+		if (clear)
+			pml4_set_dirty (page->owner->pml4, page->va, false);
+	}
+	return dirty;
+}
+
+/* Returns true if the contents of PAGE were written since they were
+ * last saved: through any mapping of its frame if it is resident, or
+ * else through its own page table entry. */
+bool
+vm_page_is_dirty (struct page *page) {
+	bool held = lock_held_by_current_thread (&frame_lock);
+	bool dirty;
+
+	if (!held)
+		lock_acquire (&frame_lock);
+	if (page->frame != NULL)
+		dirty = rmap_test_dirty (page->frame, false);
+	else
+		dirty = pml4_is_dirty (page->owner->pml4, page->va);
+	if (!held)
+		lock_release (&frame_lock);
+	return dirty;
+}
 
+/* Marks the contents of PAGE as saved, clearing the dirty bits that
+ * vm_page_is_dirty() looks at. */
+void
+vm_page_clear_dirty (struct page *page) {
+	bool held = lock_held_by_current_thread (&frame_lock);
+
+	if (!held)
+		lock_acquire (&frame_lock);
+	if (page->frame != NULL)
+		rmap_test_dirty (page->frame, true);
+	pml4_set_dirty (page->owner->pml4, page->va, false);
+	if (!held)
+		lock_release (&frame_lock);
+}
+
+/* Waits until the frame of PAGE, if any, is no longer being evicted
+ * or cleaned. Called with frame_lock held. */
+static void
+page_wait_idle_locked (struct page *page) {
+	while (page->frame != NULL && page->frame->busy)
+		cond_wait (&frame_idle, &frame_lock);
+}
+
+/* Ends what made FRAME busy. Called with frame_lock held. */
+static void
+frame_set_idle_locked (struct frame *frame) {
+	frame->busy = false;
+	cond_broadcast (&frame_idle, &frame_lock);
+}
+
+/* Returns true if FRAME is mapped by OWNER's pages alone. Called
+ * with frame_lock held. */
+static bool
+frame_owned_by (struct frame *frame, struct thread *owner) {
+	struct list_elem *e;
+
+	for (e = list_begin (&frame->rmap); e != list_end (&frame->rmap);
+			e = list_next (e))
+		if (list_entry (e, struct page, rmap_elem)->owner != owner)
+			return false;
+	return true;
+}
+
+/* Get the struct frame, that will be evicted.
+ * Second-chance clock over the frame table: a frame that any of its
+ * pages accessed since the last sweep gets their accessed bits cleared
+ * and is skipped once. Frames shared between address spaces are
+ * candidates like any other, but not those pinned, busy, or also held
+ * by something other than their pages, such as a shared area. If
+ * OWNER is not NULL, only frames of that process are considered.
+ * Called with frame_lock held. */
+static struct frame *
+vm_get_victim (struct thread *owner) {
+	for (size_t i = 0; i < 2 * frame_cnt; i++) {
+		struct frame *frame = &frame_table[clock_hand];
+
+		clock_hand = (clock_hand + 1) % frame_cnt;
+
+		if (list_empty (&frame->rmap) || frame->pin_cnt > 0 || frame->huge
+				|| frame->busy || frame->ref_cnt != list_size (&frame->rmap))
+			continue;
+		if (owner != NULL && !frame_owned_by (frame, owner))
+			continue;
+		if (rmap_test_and_clear_accessed (frame))
+			continue;
+		return frame;
+	}
 	return NULL;
 }
 
+/* Evict one page and return the corresponding frame. With OWNER,
+ * the page is one of that process's.
+ * Return NULL on error.
+ * Called with frame_lock held, which is dropped while the pages are
+ * written out. */
+static struct frame *
+vm_evict_frame (struct thread *owner) {
+	struct frame *victim = vm_get_victim (owner);
+	bool evicted = true;
+
+	/* Huge pages are only reclaimed once nothing else is left: split
+	 * one so that its frames can be evicted one by one. */
+	if (victim == NULL) {
+		for (size_t i = 0; i < frame_cnt; i++)
+			if (frame_table[i].huge
+					&& (owner == NULL || frame_owned_by (&frame_table[i], owner))
+					&& vm_huge_split_locked (&frame_table[i])) {
+				victim = vm_get_victim (owner);
+				break;
+			}
+		if (victim == NULL)
+			return NULL;
+	}
+
+	/* swap_out() unmaps a page and saves its contents, each page of a
+	 * shared frame on its own. It refuses, leaving the page mapped,
+	 * when it cannot do so without blocking; the frame then stays
+	 * with the pages not evicted yet. The victim is busy meanwhile, so
+	 * that its pages and rmap stay as they are while frame_lock is
+	 * dropped for the I/O. */
+	victim->busy = true;
+	while (!list_empty (&victim->rmap)) {
+		struct page *page = list_entry (list_front (&victim->rmap),
+				struct page, rmap_elem);
+		bool saved;
+
+		lock_release (&frame_lock);
+		saved = swap_out (page);
+		lock_acquire (&frame_lock);
+		if (!saved) {
+			evicted = false;
+			break;
+		}
+		page->owner->rusage.evictions++;
+		rmap_remove (victim, page);
+		victim->ref_cnt--;
+	}
+	frame_set_idle_locked (victim);
+	if (!evicted)
+		return NULL;
+	ASSERT (victim->ref_cnt == 0);
+
+	if (victim->text != NULL)
+		text_cache_remove_locked (victim);
+	return victim;
+}
+
 /* palloc() and get frame. If there is no available page, evict the page
  * and return it. This always return valid address. That is, if the user pool
  * memory is full, this function evicts the frame to get the available memory
- * space.*/
-static struct frame * vm_get_frame (void) {
-    struct frame *frame = NULL;
-    void *kva;
+ * space.
+ * The returned frame has one reference and is pinned; the caller
+ * unpins it once the page it backs is fully set up. */
+static struct frame *
+vm_get_frame (void) {
+	struct thread *t = thread_current ();
+	struct frame *frame = NULL;
+	void *kva;
+
+	lock_acquire (&frame_lock);
+	/* A process at its resident limit pages against itself, leaving
+	 * the frames of other processes alone. */
+	if (t->rss_limit > 0 && t->rss >= t->rss_limit)
+		frame = vm_evict_frame (t);
+	while (frame == NULL) {
+		kva = palloc_get_page (PAL_USER);
+		if (kva != NULL) {
+			frame = frame_lookup (kva);
+			break;
+		}
+
+		/* Leave eviction to reclaimd unless it ran out of victims,
+		 * e.g. because they all wait on a lock this thread holds. */
+		if (vm_reclaim_high > 0 && !reclaim_stuck) {
+			reclaim_wake_locked ();
+			cond_wait (&frame_freed, &frame_lock);
+			continue;
+		}
+
+		frame = vm_evict_frame (NULL);
+		if (frame == NULL) {
+			/* Every candidate is pinned or waits on a lock another
+			 * thread holds; let that thread make progress. */
+			lock_release (&frame_lock);
+			thread_yield ();
+			lock_acquire (&frame_lock);
+		}
+	}
+	ASSERT (frame->ref_cnt == 0);
+	ASSERT (list_empty (&frame->rmap));
+	frame->ref_cnt = 1;
+	frame->pin_cnt = 1;
+	if (palloc_user_free_cnt () < vm_reclaim_low)
+		reclaim_wake_locked ();
+	lock_release (&frame_lock);
+
+	text_cache_reap ();
+	return frame;
+}
+
+/* Wakes up reclaimd unless it is already running. Called with
+ * frame_lock held. */
+static void
+reclaim_wake_locked (void) {
+	if (!reclaim_running) {
+		reclaim_running = true;
+		sema_up (&reclaim_sema);
+	}
+}
+
+/* Writes back dirty file pages the clock hand is about to reach, so
+ * that evicting them later needs no I/O. Anonymous pages are left to
+ * eviction. Called with frame_lock held, which is dropped while a
+ * page is written. */
+static void
+reclaim_clean_locked (void) {
+	for (size_t i = 0; i < RECLAIM_CLEAN_CNT && i < frame_cnt; i++) {
+		struct frame *frame = &frame_table[(clock_hand + i) % frame_cnt];
+		struct page *page;
+		bool cleaned;
+
+		if (list_empty (&frame->rmap) || frame->pin_cnt > 0 || frame->huge
+				|| frame->busy)
+			continue;
+		page = list_entry (list_front (&frame->rmap), struct page, rmap_elem);
+		if (VM_TYPE (page->operations->type) != VM_FILE)
+			continue;
+
+		frame->busy = true;
+		lock_release (&frame_lock);
+		cleaned = file_backed_clean (page);
+		lock_acquire (&frame_lock);
+		frame_set_idle_locked (frame);
+		if (!cleaned)
+			break;
+	}
+}
 
-    kva = palloc_get_page(PAL_USER);
-    if (kva == NULL) {
-        PANIC("todo");
-    }
+/* Reclaim daemon. Evicts frames until vm_reclaim_high are free each
+ * time it is woken up, then cleans the frames ahead of the clock. */
+static void
+reclaimd (void *aux UNUSED) {
+	for (;;) {
+		sema_down (&reclaim_sema);
 
-    frame = malloc(sizeof(struct frame));
-    if (frame == NULL) {
-        palloc_free_page(kva);
-        return NULL;
-    }
+		lock_acquire (&frame_lock);
+		reclaim_stuck = false;
+		while (palloc_user_free_cnt () < vm_reclaim_high) {
+			struct frame *frame = vm_evict_frame (NULL);
 
-    frame->kva = kva;
-    frame->page = NULL;
+			if (frame == NULL) {
+				reclaim_stuck = true;
+				break;
+			}
+			palloc_free_page (frame->kva);
+			cond_broadcast (&frame_freed, &frame_lock);
+
+			/* Let faulting threads have the frame_lock in between. */
+			lock_release (&frame_lock);
+			text_cache_reap ();
+			lock_acquire (&frame_lock);
+		}
+		if (!reclaim_stuck)
+			reclaim_clean_locked ();
+		reclaim_running = false;
+		cond_broadcast (&frame_freed, &frame_lock);
+		lock_release (&frame_lock);
+
+		text_cache_reap ();
+	}
+}
+
+/* Picks the watermarks and starts reclaimd. */
+static void
+reclaim_init (void) {
+	if (vm_reclaim_low == 0)
+		vm_reclaim_low = frame_cnt / 64;
+	if (vm_reclaim_high == 0)
+		vm_reclaim_high = frame_cnt / 32;
+	if (vm_reclaim_high < vm_reclaim_low)
+		vm_reclaim_high = vm_reclaim_low;
+
+	sema_init (&reclaim_sema, 0);
+	cond_init (&frame_freed);
+	if (vm_reclaim_high > 0
+			&& thread_create ("reclaimd", PRI_DEFAULT, reclaimd, NULL) == TID_ERROR)
+		PANIC ("cannot start reclaimd");
+}
+
+/* Drops one reference to FRAME, held by PAGE, and frees the frame
+ * once nobody maps it. Called with frame_lock held. */
+static void
+frame_put_locked (struct frame *frame, struct page *page) {
+	ASSERT (frame->ref_cnt > 0);
+
+	if (page != NULL && page->frame == frame)
+		rmap_remove (frame, page);
+
+	if (--frame->ref_cnt == 0) {
+		ASSERT (!frame->huge);
+		ASSERT (list_empty (&frame->rmap));
+		if (frame->text != NULL)
+			text_cache_remove_locked (frame);
+		frame->pin_cnt = 0;
+		palloc_free_page (frame->kva);
+	}
+}
+
+/* Unmaps PAGE and pins its frame so that the clock leaves it alone
+ * while the caller writes it back or frees it. Returns the frame, or
+ * NULL if PAGE is not resident. */
+struct frame *
+vm_frame_detach (struct page *page) {
+	struct frame *frame;
+
+	lock_acquire (&frame_lock);
+	page_wait_idle_locked (page);
+	frame = page->frame;
+	if (frame != NULL) {
+		if (frame->huge && !vm_huge_split_locked (frame))
+			PANIC ("out of memory splitting a huge page");
+		frame->pin_cnt++;
+		pml4_clear_page (page->owner->pml4, page->va);
+	}
+	lock_release (&frame_lock);
+	return frame;
+}
+
+/* Releases PAGE's reference to FRAME, previously detached with
+ * vm_frame_detach(). The frame returns to the user pool when PAGE
+ * was its last user. */
+void
+vm_frame_free (struct frame *frame, struct page *page) {
+	lock_acquire (&frame_lock);
+	frame->pin_cnt--;
+	frame_put_locked (frame, page);
+	lock_release (&frame_lock);
+
+	text_cache_reap ();
+}
+
+/* Drops a reference to FRAME that no page holds, such as the one of
+ * a shared area. */
+void
+vm_frame_put (struct frame *frame) {
+	lock_acquire (&frame_lock);
+	frame_put_locked (frame, NULL);
+	lock_release (&frame_lock);
+}
+
+/* Pins the frame of PAGE. If PAGE is not resident, it is first
+ * claimed into its owner's address space when CLAIM is true; otherwise
+ * NULL is returned. Also returns NULL if claiming fails. */
+struct frame *
+vm_pin_page (struct page *page, bool claim) {
+	for (;;) {
+		lock_acquire (&frame_lock);
+		page_wait_idle_locked (page);
+		if (page->frame != NULL) {
+			page->frame->pin_cnt++;
+			lock_release (&frame_lock);
+			return page->frame;
+		}
+		lock_release (&frame_lock);
+
+		if (!claim || !vm_do_claim_page (page))
+			return NULL;
+	}
+}
 
-    ASSERT (frame != NULL);
-    ASSERT (frame->page == NULL);
-    return frame;
+void
+vm_unpin_frame (struct frame *frame) {
+	lock_acquire (&frame_lock);
+	ASSERT (frame->pin_cnt > 0);
+	frame->pin_cnt--;
+	lock_release (&frame_lock);
 }
 
 static bool vm_stack_growth (void *addr) {
 	struct supplemental_page_table *spt;
+	struct vma *stack;
 	void *stack_bottom = pg_round_down (addr);
 
 	spt = &thread_current ()->spt;
 
 	if (spt_find_page (spt, stack_bottom) != NULL) 
 		return true;
+
+	stack = vma_find (spt, (uint8_t *) USER_STACK - 1);
+	if (stack == NULL || !vma_extend_down (spt, stack, stack_bottom))
+		return false;
 	
-	return vm_alloc_page(VM_ANON | VM_MARKER_0, stack_bottom, true);
+	if (!vm_alloc_page(VM_ANON | VM_MARKER_0, stack_bottom, true))
+		return false;
+	thread_current ()->rusage.stack_growths++;
+	return true;
 }
 
-/* Handle the fault on write_protected page */
+/* Handle the fault on write_protected page.
+ * PAGE is logically writable but mapped read-only because its frame
+ * is shared copy-on-write. The first write gives PAGE a private copy;
+ * if every other sharer is already gone, the frame is simply adopted
+ * without allocating one. */
 static bool
-vm_handle_wp (struct page *page UNUSED) {
+vm_handle_wp (struct page *page) {
+	struct frame *old, *new = NULL;
+	uint64_t *pml4 = page->owner->pml4;
+
+	lock_acquire (&frame_lock);
+	for (;;) {
+		page_wait_idle_locked (page);
+		old = page->frame;
+		if (old == NULL || old->ref_cnt == 1) {
+			/* If OLD is gone the page was evicted meanwhile, and the
+			 * retried access faults it back in as not-present. */
+			if (old != NULL)
+				pml4_set_writable (pml4, page->va, true);
+			if (new != NULL)
+				frame_put_locked (new, NULL);
+			lock_release (&frame_lock);
+			return true;
+		}
+		if (new != NULL)
+			break;
+
+		/* The sharers may go away while the copy is allocated. */
+		lock_release (&frame_lock);
+		new = vm_get_frame ();
+		lock_acquire (&frame_lock);
+	}
+
+	/* PAGE keeps its reference to OLD, pinned, until the new mapping is
+	 * in place, so that a failure can put everything back. */
+	memcpy (new->kva, old->kva, PGSIZE);
+	old->pin_cnt++;
+	rmap_remove (old, page);
+	rmap_add (new, page);
+	lock_release (&frame_lock);
+
+	if (!pml4_set_page (pml4, page->va, new->kva, true)) {
+		lock_acquire (&frame_lock);
+		frame_put_locked (new, page);
+		rmap_add (old, page);
+		old->pin_cnt--;
+		lock_release (&frame_lock);
+		return false;
+	}
+
+	lock_acquire (&frame_lock);
+	old->pin_cnt--;
+	frame_put_locked (old, NULL);
+	new->pin_cnt--;
+	lock_release (&frame_lock);
+	return true;
 }
 
 bool vm_try_handle_fault (struct intr_frame *f, void *addr,	bool user, bool write, bool not_present) {
@@ -203,11 +844,32 @@ bool vm_try_handle_fault (struct intr_frame *f, void *addr,	bool user, bool writ
 
 	spt = &thread_current ()->spt;
 
-	if (addr == NULL || is_kernel_vaddr (addr) || !not_present)
+	/* Only faults on valid user pages count towards rusage.faults;
+	 * the others kill the process or are kernel bugs. */
+	if (addr == NULL || is_kernel_vaddr (addr))
 		return false;
 
 	page_addr = pg_round_down (addr);
-	page = spt_find_page (spt, page_addr);
+
+	if (!not_present) {
+		page = spt_find_page (spt, page_addr);
+		if (!write || page == NULL || !page->writable)
+			return false;
+		thread_current ()->rusage.faults++;
+
+		/* First write to a page that so far only mapped zero_page. */
+		if (VM_TYPE (page->operations->type) == VM_UNINIT) {
+			vm_zero_unmap (page);
+			return vm_do_claim_page (page);
+		}
+		return vm_handle_wp (page);
+	}
+
+	if (write && vm_claim_huge (spt, page_addr)) {
+		thread_current ()->rusage.faults++;
+		return true;
+	}
+	page = spt_lookup_page (spt, page_addr);
 
 	if (page == NULL) {
 		if (!should_grow_stack (f, addr, user) || !vm_stack_growth (page_addr))
@@ -221,24 +883,497 @@ bool vm_try_handle_fault (struct intr_frame *f, void *addr,	bool user, bool writ
 
 	if (write && !page->writable)
 		return false;
+	thread_current ()->rusage.faults++;
 
+	if (page_settle (page) || prefetch_claim (page))
+		return true;
+	if (!write && vm_map_zero_page (page))
+		return true;
+	if (vm_claim_around (page, fault_around_window (page)))
+		return true;
+	if (vm_swap_in_around (page, swap_readahead_window (page)))
+		return true;
 	return vm_do_claim_page (page);
 }
 
+/* Loads the pages of [START, END) in the current address space that
+ * are not resident, ahead of their use, for MAP_POPULATE. File
+ * contents are read in batches of FAULT_AROUND_MAX pages. */
+void
+vm_prefetch (void *start, void *end) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+
+	for (uint8_t *va = start; va < (uint8_t *) end; va += PGSIZE) {
+		struct page *page = spt_lookup_page (spt, va);
+
+		if (page == NULL || page->frame != NULL || prefetch_claim (page))
+			continue;
+		if (!vm_claim_around (page, FAULT_AROUND_MAX))
+			vm_do_claim_page (page);
+	}
+}
+
+/* Creates a request for prefetchd to read the contents of PAGE, which
+ * is not resident, into a frame. Returns NULL if they are not on disk,
+ * or the text cache holds them, or memory is short. */
+static struct prefetch *
+prefetch_create (struct page *page) {
+	struct prefetch *p;
+	struct file *file = NULL;
+	off_t ofs = 0;
+	size_t read_bytes = PGSIZE;
+	size_t slot = BITMAP_ERROR;
+
+	page_reload_text (page);
+	if (lazy_file_range (page, &file, &ofs, &read_bytes)) {
+		if (read_bytes == 0
+				|| ((page->uninit.type & VM_TEXT) && text_cache_contains (page)))
+			return NULL;
+	} else if (VM_TYPE (page->operations->type) == VM_FILE) {
+		file = page->file.file;
+		ofs = page->file.ofs;
+		read_bytes = page->file.read_bytes;
+		if (read_bytes == 0)
+			return NULL;
+	} else if (VM_TYPE (page->operations->type) != VM_ANON
+			|| (slot = anon_swap_slot (page)) == BITMAP_ERROR)
+		return NULL;
+
+	p = malloc (sizeof *p);
+	if (p == NULL)
+		return NULL;
+	p->file = NULL;
+	if (file != NULL) {
+		bool held = lock_held_by_current_thread (&file_lock);
+
+		if (!held)
+			lock_acquire (&file_lock);
+		p->file = file_reopen (file);
+		if (!held)
+			lock_release (&file_lock);
+		if (p->file == NULL) {
+			free (p);
+			return NULL;
+		}
+	}
+	p->va = page->va;
+	p->frame = vm_get_frame ();
+	p->ofs = ofs;
+	p->read_bytes = read_bytes;
+	p->slot = slot;
+	p->state = PREFETCH_QUEUED;
+	p->loaded = false;
+	return p;
+}
+
+/* Queues the pages of [START, END) in the current address space whose
+ * contents are on disk for prefetchd to read, and returns without
+ * waiting for them. Stops before it would make reclaim evict, and
+ * once PREFETCH_MAX pages wait to be mapped. */
+void
+vm_willneed (void *start, void *end) {
+	struct thread *t = thread_current ();
+	struct list *prefetches = &t->spt.prefetches;
+
+	for (uint8_t *va = start; va < (uint8_t *) end; va += PGSIZE) {
+		struct page *page;
+		struct prefetch *p;
+
+		if (palloc_user_free_cnt () <= vm_reclaim_high
+				|| list_size (prefetches) >= PREFETCH_MAX
+				|| (t->rss_limit > 0
+					&& t->rss + list_size (prefetches) >= t->rss_limit))
+			break;
+
+		page = spt_lookup_page (&t->spt, va);
+		if (page == NULL || page->frame != NULL || prefetch_find (page) != NULL
+				|| (p = prefetch_create (page)) == NULL)
+			continue;
+
+		list_push_back (prefetches, &p->elem);
+		lock_acquire (&prefetch_lock);
+		list_push_back (&prefetch_queue, &p->queue_elem);
+		lock_release (&prefetch_lock);
+		sema_up (&prefetch_sema);
+	}
+}
+
+/* Returns the request to prefetch PAGE, if any. Only called by PAGE's
+ * owner. */
+static struct prefetch *
+prefetch_find (struct page *page) {
+	struct list *prefetches = &page->owner->spt.prefetches;
+	struct list_elem *e;
+
+	for (e = list_begin (prefetches); e != list_end (prefetches);
+			e = list_next (e))
+		if (list_entry (e, struct prefetch, elem)->va == page->va)
+			return list_entry (e, struct prefetch, elem);
+	return NULL;
+}
+
+/* Removes the request to prefetch PAGE, if any, from its owner and
+ * returns it once prefetchd is done with it. A request prefetchd has
+ * not started yet is dropped unread. */
+static struct prefetch *
+prefetch_take (struct page *page) {
+	struct prefetch *p = prefetch_find (page);
+
+	if (p == NULL)
+		return NULL;
+	list_remove (&p->elem);
+
+	lock_acquire (&prefetch_lock);
+	if (p->state == PREFETCH_QUEUED)
+		list_remove (&p->queue_elem);
+	while (p->state == PREFETCH_READING)
+		cond_wait (&prefetch_done, &prefetch_lock);
+	lock_release (&prefetch_lock);
+	return p;
+}
+
+/* Frees P, along with its frame unless that was mapped. */
+static void
+prefetch_free (struct prefetch *p) {
+	if (p->file != NULL) {
+		bool held = lock_held_by_current_thread (&file_lock);
+
+		if (!held)
+			lock_acquire (&file_lock);
+		file_close (p->file);
+		if (!held)
+			lock_release (&file_lock);
+	}
+	if (p->frame != NULL)
+		vm_frame_free (p->frame, NULL);
+	free (p);
+}
+
+/* Maps FRAME, which prefetchd filled with the contents of PAGE, at
+ * PAGE. */
+static bool
+prefetch_map (struct page *page, struct frame *frame) {
+	enum vm_type type = VM_TYPE (page->operations->type);
+	bool text = type == VM_UNINIT && (page->uninit.type & VM_TEXT);
+	struct text_entry key;
+
+	if (text) {
+		struct file *file;
+
+		lazy_file_range (page, &file, &key.ofs, &key.read_bytes);
+		key.inode = file_get_inode (file);
+	}
+
+	lock_acquire (&frame_lock);
+	rmap_add (frame, page);
+	lock_release (&frame_lock);
+	if (type == VM_UNINIT)
+		vm_finish_uninit (page, frame->kva);
+
+	if (!pml4_set_page (page->owner->pml4, page->va, frame->kva, page->writable)) {
+		vm_frame_free (frame, page);
+		return false;
+	}
+	if (type == VM_ANON)
+		anon_swap_release (page);
+	vm_unpin_frame (frame);
+
+	rusage_count_load (page, type);
+	if (text)
+		text_cache_publish (page, &key);
+	return true;
+}
+
+/* Maps PAGE to the frame prefetchd read its contents into, if any.
+ * Returns true if PAGE is now resident. */
+static bool
+prefetch_claim (struct page *page) {
+	struct prefetch *p;
+	bool mapped = false;
+
+	if (list_empty (&page->owner->spt.prefetches)
+			|| (p = prefetch_take (page)) == NULL)
+		return false;
+
+	if (p->state == PREFETCH_DONE && p->loaded) {
+		mapped = prefetch_map (page, p->frame);
+		p->frame = NULL;
+	}
+	prefetch_free (p);
+	return mapped;
+}
+
+/* Drops the request to prefetch PAGE, if any, before PAGE goes. */
+static void
+prefetch_cancel (struct page *page) {
+	struct prefetch *p;
+
+	if (!list_empty (&page->owner->spt.prefetches)
+			&& (p = prefetch_take (page)) != NULL)
+		prefetch_free (p);
+}
+
+/* Prefetch daemon. Reads the contents of queued pages, oldest request
+ * first. */
+static void
+prefetchd (void *aux UNUSED) {
+	for (;;) {
+		struct prefetch *p;
+
+		sema_down (&prefetch_sema);
+
+		/* A request is only started with file_lock held, so that a
+		 * process holding file_lock never waits for one. */
+		lock_acquire (&file_lock);
+		lock_acquire (&prefetch_lock);
+		if (list_empty (&prefetch_queue)) {
+			/* Its request was dropped. */
+			lock_release (&prefetch_lock);
+			lock_release (&file_lock);
+			continue;
+		}
+		p = list_entry (list_pop_front (&prefetch_queue),
+				struct prefetch, queue_elem);
+		p->state = PREFETCH_READING;
+		lock_release (&prefetch_lock);
+
+		if (p->file != NULL) {
+			p->loaded = file_read_at (p->file, p->frame->kva, p->read_bytes,
+					p->ofs) == (off_t) p->read_bytes;
+			file_close (p->file);
+			p->file = NULL;
+			lock_release (&file_lock);
+		} else {
+			lock_release (&file_lock);
+			anon_swap_read (p->slot, 1, p->frame->kva);
+			p->loaded = true;
+		}
+		memset (p->frame->kva + p->read_bytes, 0, PGSIZE - p->read_bytes);
+
+		lock_acquire (&prefetch_lock);
+		p->state = PREFETCH_DONE;
+		cond_broadcast (&prefetch_done, &prefetch_lock);
+		lock_release (&prefetch_lock);
+	}
+}
+
+/* Starts prefetchd. */
+static void
+prefetch_init (void) {
+	list_init (&prefetch_queue);
+	lock_init (&prefetch_lock);
+	cond_init (&prefetch_done);
+	sema_init (&prefetch_sema, 0);
+	if (thread_create ("prefetchd", PRI_DEFAULT, prefetchd, NULL) == TID_ERROR)
+		PANIC ("cannot start prefetchd");
+}
+
+/* Drops the pages of [START, END) in the current address space that
+ * their memory area can rebuild: anonymous pages, whose contents are
+ * lost, and file pages not written since they were loaded. The next
+ * access faults them in afresh. */
+void
+vm_discard (void *start, void *end) {
+	struct thread *t = thread_current ();
+
+	for (uint8_t *va = start; va < (uint8_t *) end; va += PGSIZE) {
+		struct page *page = spt_find_page (&t->spt, va);
+
+		if (page == NULL || page->vma == NULL)
+			continue;
+		if (page_get_type (page) == VM_FILE && vm_page_is_dirty (page))
+			continue;
+		spt_remove_page (&t->spt, page);
+	}
+}
+
+/* Returns true if PAGE is an anonymous page that has not been loaded
+ * yet and would start out all zeros. */
+static bool
+page_is_zero_fill (struct page *page) {
+	struct uninit_page *uninit = &page->uninit;
+
+	if (VM_TYPE (page->operations->type) != VM_UNINIT
+			|| VM_TYPE (uninit->type) != VM_ANON)
+		return false;
+	return uninit->init == NULL;
+}
+
+/* Maps zero_page read-only at PAGE if it would start out all zeros.
+ * Its frame is only allocated by the first write. */
+static bool
+vm_map_zero_page (struct page *page) {
+	if (!page_is_zero_fill (page))
+		return false;
+
+	return pml4_set_page (page->owner->pml4, page->va, zero_page, false);
+}
+
+/* Backs the whole 2 MiB block around VA with one huge page, mapped by
+ * a single page directory entry. Only done for blocks that lie in a
+ * writable anonymous area, start out all zeros and have no page
+ * touched yet, and only if the user pool has a free, aligned run of
+ * frames; nothing is evicted to make room. */
+static bool
+vm_claim_huge (struct supplemental_page_table *spt, void *va) {
+	struct thread *t = thread_current ();
+	uint8_t *base = huge_round_down (va);
+	struct vma *vma = vma_find (spt, va);
+	uint8_t *kva;
+	size_t i;
+
+	if (vma == NULL || VM_TYPE (vma->type) != VM_ANON || !vma->writable
+			|| vma->shm != NULL
+			|| base < (uint8_t *) vma->start
+			|| base + HUGE_PGSIZE > (uint8_t *) vma->end
+			|| (size_t) (base - (uint8_t *) vma->start) < vma->read_bytes)
+		return false;
+
+	if (spt_find_page (spt, va) != NULL)
+		return false;
+	for (i = 0; i < HUGE_PGCNT; i++)
+		if (spt_find_page (spt, base + i * PGSIZE) != NULL)
+			return false;
+
+	/* The huge page takes HUGE_PGCNT frames at once. Unless they fit
+	 * under the resident limit and above the low watermark, fall back
+	 * to a single page, which reclaim can make room for. */
+	if (t->rss_limit > 0 && t->rss + HUGE_PGCNT > t->rss_limit)
+		return false;
+	if (palloc_user_free_cnt () < vm_reclaim_low + HUGE_PGCNT)
+		return false;
+
+	kva = palloc_get_aligned (PAL_USER, HUGE_PGCNT, HUGE_PGCNT);
+	if (kva == NULL)
+		return false;
+
+	for (i = 0; i < HUGE_PGCNT; i++) {
+		struct page *page = vma_materialize (vma, base + i * PGSIZE);
+
+		if (page == NULL)
+			goto fail;
+		/* anon_initializer() zeroes pages without a loader itself. */
+		if (page->uninit.init != NULL)
+			memset (kva + i * PGSIZE, 0, PGSIZE);
+		vm_finish_uninit (page, kva + i * PGSIZE);
+	}
+	t->rusage.lazy_loads += HUGE_PGCNT;
+
+	lock_acquire (&frame_lock);
+	for (i = 0; i < HUGE_PGCNT; i++) {
+		struct page *page = spt_find_page (spt, base + i * PGSIZE);
+		struct frame *frame = frame_lookup (kva + i * PGSIZE);
+
+		frame->ref_cnt = 1;
+		frame->huge = true;
+		rmap_add (frame, page);
+	}
+	if (!pml4_set_huge_page (t->pml4, base, kva, true)) {
+		/* Fall back to mapping the frames one by one. */
+		vm_huge_split_locked (frame_lookup (kva));
+		for (i = 0; i < HUGE_PGCNT; i++)
+			if (!pml4_set_page (t->pml4, base + i * PGSIZE, kva + i * PGSIZE, true))
+				PANIC ("out of memory mapping a huge page");
+	}
+	if (palloc_user_free_cnt () < vm_reclaim_low)
+		reclaim_wake_locked ();
+	lock_release (&frame_lock);
+	return true;
+
+fail:
+	while (i-- > 0)
+		spt_remove_page (spt, spt_find_page (spt, base + i * PGSIZE));
+	palloc_free_multiple (kva, HUGE_PGCNT);
+	return false;
+}
+
+/* Breaks the huge page FRAME belongs to back into 4 KiB mappings of
+ * the same frames, which from then on are ordinary frames. Returns
+ * false if memory for the page table runs out. Called with frame_lock
+ * held. */
+static bool
+vm_huge_split_locked (struct frame *frame) {
+	struct frame *head = frame - (pg_no (frame->kva) % HUGE_PGCNT);
+	struct page *page;
+
+	ASSERT (frame->huge);
+	ASSERT (list_size (&frame->rmap) == 1);
+
+	page = list_entry (list_front (&frame->rmap), struct page, rmap_elem);
+	if (!pml4_split_huge_page (page->owner->pml4, huge_round_down (page->va)))
+		return false;
+	vm_huge_unmark (head->kva);
+	return true;
+}
+
+/* Turns the frames of the huge page at KVA back into ordinary frames.
+ * The page table code calls this whenever it splits a huge mapping,
+ * including the splits done implicitly by pml4_*() functions that
+ * change 4 KiB entries. */
+void
+vm_huge_unmark (void *kva) {
+	struct frame *head = frame_lookup (kva);
+	bool held = lock_held_by_current_thread (&frame_lock);
+
+	if (!held)
+		lock_acquire (&frame_lock);
+	for (size_t i = 0; i < HUGE_PGCNT; i++)
+		head[i].huge = false;
+	if (!held)
+		lock_release (&frame_lock);
+}
+
+/* Turns PAGE back into a segment page not loaded yet if eviction
+ * dropped its contents, see anon_swap_out(). Only called by PAGE's
+ * owner. */
+static void
+page_reload_text (struct page *page) {
+	if (page->frame == NULL && VM_TYPE (page->operations->type) == VM_ANON
+			&& page->vma != NULL && (page->vma->type & VM_TEXT))
+		vma_unload (page->vma, page);
+}
+
+/* Waits out an eviction of PAGE in progress before its owner faults
+ * it in. Returns true if PAGE stayed mapped, so that the access only
+ * needs to be retried. */
+static bool
+page_settle (struct page *page) {
+	bool mapped;
+
+	lock_acquire (&frame_lock);
+	page_wait_idle_locked (page);
+	mapped = page->frame != NULL
+		&& pml4_get_page (page->owner->pml4, page->va) != NULL;
+	lock_release (&frame_lock);
+
+	if (!mapped)
+		page_reload_text (page);
+	return mapped;
+}
+
+/* Removes the mapping of zero_page at PAGE, if any. */
+void
+vm_zero_unmap (struct page *page) {
+	uint64_t *pml4 = page->owner->pml4;
+
+	if (pml4 != NULL && pml4_get_page (pml4, page->va) == zero_page)
+		pml4_clear_page (pml4, page->va);
+}
+
 
-/* Free the page.
- * DO NOT MODIFY THIS FUNCTION. */
+/* Free the page. */
 void
 vm_dealloc_page (struct page *page) {
+	prefetch_cancel (page);
 	destroy (page);
-	free (page);
+	slab_free (page);
 }
 
 /* Claim the page that allocate on VA. */
 bool vm_claim_page (void *va) {
 	struct page *page = NULL;
 	
-	page = spt_find_page(&thread_current()->spt, va);
+	page = spt_lookup_page (&thread_current ()->spt, va);
 
 	if (page == NULL) 
 		return false;
@@ -246,36 +1381,503 @@ bool vm_claim_page (void *va) {
 	return vm_do_claim_page (page);
 }
 
+/* Counts loading PAGE, which was of TYPE, towards its owner's
+ * rusage. */
+static void
+rusage_count_load (struct page *page, enum vm_type type) {
+	struct rusage *usage = &page->owner->rusage;
+
+	if (type == VM_UNINIT)
+		usage->lazy_loads++;
+	else if (type == VM_FILE)
+		usage->file_reads++;
+	else
+		usage->swap_ins++;
+}
+
 /* Claim the PAGE and set up the mmu. */
 static bool vm_do_claim_page (struct page *page) {
-    struct frame *frame;
-	
-	if (page == NULL) 
+	if (page == NULL)
 		return false;
-	
+	page_reload_text (page);
+	if (prefetch_claim (page))
+		return true;
+
+	rusage_count_load (page, VM_TYPE (page->operations->type));
+
+	if (VM_TYPE (page->operations->type) == VM_UNINIT
+			&& (page->uninit.type & VM_TEXT))
+		return vm_claim_text_page (page);
+	if (VM_TYPE (page->operations->type) == VM_UNINIT
+			&& page->uninit.init == vma_shared_init)
+		return vm_claim_shared_page (page);
+
+	return vm_claim_frame (page);
+}
+
+/* Backs PAGE with a frame of its own and loads its contents. */
+static bool vm_claim_frame (struct page *page) {
+	struct frame *frame;
+
 	frame = vm_get_frame ();
-    frame->page = page;
-    page->frame = frame;
+	lock_acquire (&frame_lock);
+	rmap_add (frame, page);
+	lock_release (&frame_lock);
 
-    if (!pml4_set_page(thread_current()->pml4, page->va, frame->kva, page->writable)){
-		palloc_free_page(frame->kva);
-		free(frame);
-		page->frame = NULL;
+	/* Fill the frame before it becomes visible to the process. */
+	if (!swap_in (page, frame->kva))
+		goto fail;
+
+	if (!pml4_set_page (page->owner->pml4, page->va, frame->kva, page->writable))
+		goto fail;
+
+	vm_unpin_frame (frame);
+	return true;
+
+fail:
+	vm_frame_free (frame, page);
+	return false;
+}
+
+/* Claims a not yet loaded read-only segment page. If another process
+ * already loaded the same file contents, PAGE maps that frame;
+ * otherwise the page is loaded normally and its frame is published in
+ * the text cache. */
+static bool vm_claim_text_page (struct page *page) {
+	struct text_entry key;
+	struct hash_elem *e;
+	struct frame *frame = NULL;
+	struct file *file;
+
+	lazy_file_range (page, &file, &key.ofs, &key.read_bytes);
+	key.inode = file_get_inode (file);
+
+	/* A frame under eviction is about to leave the cache. */
+	lock_acquire (&frame_lock);
+	e = hash_find (&text_cache, &key.elem);
+	if (e != NULL && !hash_entry (e, struct text_entry, elem)->frame->busy) {
+		frame = hash_entry (e, struct text_entry, elem)->frame;
+		frame->ref_cnt++;
+		frame->pin_cnt++;
+		rmap_add (frame, page);
+	}
+	lock_release (&frame_lock);
+
+	if (frame == NULL) {
+		if (!vm_claim_frame (page))
+			return false;
+		text_cache_publish (page, &key);
+		return true;
+	}
+
+	vm_finish_uninit (page, frame->kva);
+
+	if (!pml4_set_page (page->owner->pml4, page->va, frame->kva, false)) {
+		vm_frame_free (frame, page);
 		return false;
 	}
-	
-    return swap_in (page, frame->kva);
+	vm_unpin_frame (frame);
+	return true;
+}
+
+/* Claims a page of a shared anonymous area by mapping the frame the
+ * area holds for it, allocating a zeroed one on the first touch by
+ * any process. The area keeps a reference to the frame, which is
+ * therefore never evicted. */
+static bool
+vm_claim_shared_page (struct page *page) {
+	struct vma *vma = page->vma;
+	struct shmem *shm = vma->shm;
+	size_t idx = ((uint8_t *) page->va - (uint8_t *) vma->start) / PGSIZE;
+	struct frame *frame;
+
+	lock_acquire (&shm->lock);
+	frame = shm->frames[idx];
+	if (frame == NULL) {
+		/* The reference vm_get_frame() returns becomes the area's. */
+		frame = vm_get_frame ();
+		memset (frame->kva, 0, PGSIZE);
+		shm->frames[idx] = frame;
+		lock_acquire (&frame_lock);
+		frame->ref_cnt++;
+		rmap_add (frame, page);
+		lock_release (&frame_lock);
+	} else {
+		lock_acquire (&frame_lock);
+		frame->ref_cnt++;
+		frame->pin_cnt++;
+		rmap_add (frame, page);
+		lock_release (&frame_lock);
+	}
+	lock_release (&shm->lock);
+
+	vm_finish_uninit (page, frame->kva);
+
+	if (!pml4_set_page (page->owner->pml4, page->va, frame->kva, page->writable)) {
+		vm_frame_free (frame, page);
+		return false;
+	}
+	vm_unpin_frame (frame);
+	return true;
+}
+
+/* Turns not yet loaded PAGE into its final type, backed by KVA whose
+ * contents the caller has already filled in: the same transition
+ * uninit_initialize() performs, minus the read. */
+static void
+vm_finish_uninit (struct page *page, void *kva) {
+	vm_initializer *init = page->uninit.init;
+	void *aux = page->uninit.aux;
+
+	page->uninit.page_initializer (page, page->uninit.type, kva);
+	if (init == lazy_load_file) {
+		page->file = *(struct file_page *) aux;
+		slab_free (aux);
+	} else if (init == lazy_load_segment)
+		segment_put (aux);
+}
+
+/* If PAGE has not been loaded yet and its contents come from a file,
+ * stores where they come from and returns true. */
+static bool
+lazy_file_range (struct page *page, struct file **file, off_t *ofs,
+		size_t *read_bytes) {
+	if (VM_TYPE (page->operations->type) != VM_UNINIT)
+		return false;
+
+	if (page->uninit.init == lazy_load_file) {
+		struct file_page *aux = page->uninit.aux;
+
+		*file = aux->file;
+		*ofs = aux->ofs;
+		*read_bytes = aux->read_bytes;
+		return true;
+	}
+	if (page->uninit.init == lazy_load_segment) {
+		struct segment *seg = page->uninit.aux;
+
+		*file = seg->file;
+		segment_locate (seg, page->va, ofs, read_bytes);
+		return true;
+	}
+	return false;
+}
+
+/* Returns true if the text cache already holds the contents of text
+ * page PAGE. */
+static bool
+text_cache_contains (struct page *page) {
+	struct text_entry key;
+	struct file *file;
+	bool found;
+
+	lazy_file_range (page, &file, &key.ofs, &key.read_bytes);
+	key.inode = file_get_inode (file);
+
+	lock_acquire (&frame_lock);
+	found = hash_find (&text_cache, &key.elem) != NULL;
+	lock_release (&frame_lock);
+	return found;
+}
+
+/* Returns how many pages a fault on PAGE loads: vm_fault_around,
+ * unless its area was advised otherwise. Without advice the pages
+ * beyond PAGE are a guess, so as with swap read-ahead they are only
+ * loaded while memory is plentiful and the process is below its
+ * resident limit. */
+static size_t
+fault_around_window (struct page *page) {
+	struct thread *t = page->owner;
+	size_t window = vm_fault_around < FAULT_AROUND_MAX
+		? vm_fault_around : FAULT_AROUND_MAX;
+
+	if (page->vma != NULL && page->vma->advice == VMA_RANDOM)
+		return 1;
+	if (page->vma != NULL && page->vma->advice == VMA_SEQUENTIAL)
+		return FAULT_AROUND_MAX;
+	if (palloc_user_free_cnt () <= vm_reclaim_high + window)
+		return 1;
+	if (t->rss_limit > 0 && t->rss + window > t->rss_limit)
+		return 1;
+	return window;
+}
+
+/* Returns how many pages a fault on swapped out anonymous PAGE reads
+ * back: SWAP_CLUSTER, unless its area was advised otherwise. The
+ * pages beyond PAGE are a guess, so they are only read while memory
+ * is plentiful and the process is below its resident limit. */
+static size_t
+swap_readahead_window (struct page *page) {
+	struct thread *t = page->owner;
+	size_t window = SWAP_CLUSTER;
+
+	if (page->vma != NULL && page->vma->advice == VMA_RANDOM)
+		return 1;
+	if (page->vma != NULL && page->vma->advice == VMA_SEQUENTIAL)
+		window = FAULT_AROUND_MAX;
+	if (palloc_user_free_cnt () <= vm_reclaim_high + window)
+		return 1;
+	if (t->rss_limit > 0)
+		return t->rss + window <= t->rss_limit ? window : 1;
+	return window;
+}
+
+/* Fault-around: claims PAGE together with up to WINDOW - 1 following
+ * pages of the same mapping that are still waiting for their
+ * first load and continue the same file range. Their contents are read
+ * with a single file_read_at() into a bounce buffer instead of one read
+ * per fault. Returns true if PAGE ends up mapped. Otherwise the caller
+ * claims PAGE on its own: either PAGE did not qualify, or it was
+ * evicted again while the rest of the batch was being loaded. */
+static bool
+vm_claim_around (struct page *page, size_t window) {
+	struct supplemental_page_table *spt = &page->owner->spt;
+	struct page *pages[FAULT_AROUND_MAX];
+	struct file *file, *next_file;
+	off_t ofs, next_ofs;
+	size_t read_bytes, total, cnt;
+	bool text, held;
+	uint8_t *buf;
+
+	ASSERT (window <= FAULT_AROUND_MAX);
+	if (window <= 1 || !lazy_file_range (page, &file, &ofs, &read_bytes)
+			|| read_bytes == 0)
+		return false;
+
+	text = (page->uninit.type & VM_TEXT) != 0;
+	if (text && text_cache_contains (page))
+		return false;
+
+	pages[0] = page;
+	total = read_bytes;
+	for (cnt = 1; cnt < window && read_bytes == PGSIZE; cnt++) {
+		struct page *next = spt_lookup_page (spt, page->va + cnt * PGSIZE);
+
+		if (next == NULL
+				|| !lazy_file_range (next, &next_file, &next_ofs, &read_bytes)
+				|| read_bytes == 0
+				|| next->uninit.init != page->uninit.init
+				|| next->uninit.type != page->uninit.type
+				|| next->writable != page->writable
+				|| file_get_inode (next_file) != file_get_inode (file)
+				|| next_ofs != ofs + (off_t) total
+				|| (text && text_cache_contains (next))
+				|| prefetch_find (next) != NULL)
+			break;
+		pages[cnt] = next;
+		total += read_bytes;
+	}
+	if (cnt == 1)
+		return false;
+
+	buf = palloc_get_multiple (0, cnt);
+	if (buf == NULL)
+		return false;
+
+	held = lock_held_by_current_thread (&file_lock);
+	if (!held)
+		lock_acquire (&file_lock);
+	if (file_read_at (file, buf, total, ofs) != (off_t) total) {
+		if (!held)
+			lock_release (&file_lock);
+		palloc_free_multiple (buf, cnt);
+		return false;
+	}
+	if (!held)
+		lock_release (&file_lock);
+	memset (buf + total, 0, cnt * PGSIZE - total);
+
+	for (size_t i = 0; i < cnt; i++) {
+		struct page *p = pages[i];
+		struct text_entry key;
+		struct frame *frame;
+
+		if (text) {
+			struct file *key_file;
+
+			lazy_file_range (p, &key_file, &key.ofs, &key.read_bytes);
+			key.inode = file_get_inode (key_file);
+		}
+
+		frame = vm_get_frame ();
+		lock_acquire (&frame_lock);
+		rmap_add (frame, p);
+		lock_release (&frame_lock);
+		memcpy (frame->kva, buf + i * PGSIZE, PGSIZE);
+
+		vm_finish_uninit (p, frame->kva);
+
+		if (!pml4_set_page (p->owner->pml4, p->va, frame->kva, p->writable)) {
+			vm_frame_free (frame, p);
+			continue;
+		}
+		vm_unpin_frame (frame);
+		p->owner->rusage.lazy_loads++;
+		if (text)
+			text_cache_publish (p, &key);
+	}
+
+	palloc_free_multiple (buf, cnt);
+	return pages[0]->frame != NULL;
+}
+
+/* Swap readahead: brings swapped out anonymous PAGE back together with
+ * up to WINDOW - 1 following pages whose contents sit in the swap slots
+ * right after its own, as pages evicted together are placed, with a
+ * single disk transfer. The other pages are mapped speculatively.
+ * Returns false, leaving PAGE to vm_do_claim_page(), if there is
+ * nothing to read ahead. */
+static bool
+vm_swap_in_around (struct page *page, size_t window) {
+	struct supplemental_page_table *spt = &page->owner->spt;
+	struct page *pages[FAULT_AROUND_MAX];
+	size_t slot, cnt;
+	uint8_t *buf;
+
+	ASSERT (window <= FAULT_AROUND_MAX);
+	if (window <= 1 || VM_TYPE (page->operations->type) != VM_ANON
+			|| page->frame != NULL
+			|| (slot = anon_swap_slot (page)) == BITMAP_ERROR)
+		return false;
+
+	pages[0] = page;
+	for (cnt = 1; cnt < window; cnt++) {
+		struct page *next = spt_find_page (spt, page->va + cnt * PGSIZE);
+
+		if (next == NULL || VM_TYPE (next->operations->type) != VM_ANON
+				|| next->frame != NULL
+				|| anon_swap_slot (next) != slot + cnt
+				|| prefetch_find (next) != NULL)
+			break;
+		pages[cnt] = next;
+	}
+	if (cnt == 1)
+		return false;
+
+	buf = palloc_get_multiple (0, cnt);
+	if (buf == NULL)
+		return false;
+	anon_swap_read (slot, cnt, buf);
+
+	for (size_t i = 0; i < cnt; i++) {
+		struct page *p = pages[i];
+		struct frame *frame;
+
+		frame = vm_get_frame ();
+		lock_acquire (&frame_lock);
+		rmap_add (frame, p);
+		lock_release (&frame_lock);
+		memcpy (frame->kva, buf + i * PGSIZE, PGSIZE);
+
+		/* On failure the page keeps its slot for the next fault. */
+		if (!pml4_set_page (p->owner->pml4, p->va, frame->kva, p->writable)) {
+			vm_frame_free (frame, p);
+			continue;
+		}
+		anon_swap_release (p);
+		vm_unpin_frame (frame);
+		p->owner->rusage.swap_ins++;
+	}
+
+	palloc_free_multiple (buf, cnt);
+	return pages[0]->frame != NULL;
+}
+
+/* Publishes the frame of freshly loaded text page PAGE under KEY,
+ * unless the contents were cached meanwhile or the frame is gone. */
+static void
+text_cache_publish (struct page *page, const struct text_entry *key) {
+	struct text_entry *entry = malloc (sizeof *entry);
+	struct frame *frame;
+
+	lock_acquire (&frame_lock);
+	frame = page->frame;
+	if (entry != NULL && frame != NULL && frame->text == NULL
+			&& hash_find (&text_cache, (struct hash_elem *) &key->elem) == NULL) {
+		*entry = *key;
+		entry->inode = inode_reopen (key->inode);
+		entry->frame = frame;
+		frame->text = entry;
+		hash_insert (&text_cache, &entry->elem);
+		entry = NULL;
+	}
+	lock_release (&frame_lock);
+	free (entry);
+}
+
+/* Drops FRAME from the text cache. Closing the inode may touch the
+ * file system, so that part is left to text_cache_reap(). Called with
+ * frame_lock held. */
+static void
+text_cache_remove_locked (struct frame *frame) {
+	struct text_entry *entry = frame->text;
+
+	hash_delete (&text_cache, &entry->elem);
+	frame->text = NULL;
+	list_push_back (&text_reap_list, &entry->reap_elem);
+}
+
+/* Releases the inodes of entries dropped from the text cache. Must be
+ * called without frame_lock held. */
+static void
+text_cache_reap (void) {
+	for (;;) {
+		struct text_entry *entry = NULL;
+		bool held;
+
+		lock_acquire (&frame_lock);
+		if (!list_empty (&text_reap_list))
+			entry = list_entry (list_pop_front (&text_reap_list),
+					struct text_entry, reap_elem);
+		lock_release (&frame_lock);
+
+		if (entry == NULL)
+			return;
+
+		held = lock_held_by_current_thread (&file_lock);
+		if (!held)
+			lock_acquire (&file_lock);
+		inode_close (entry->inode);
+		if (!held)
+			lock_release (&file_lock);
+		free (entry);
+	}
+}
+
+static uint64_t text_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct text_entry *entry = hash_entry (e, struct text_entry, elem);
+	uint64_t key[3] = { (uint64_t) entry->inode, entry->ofs, entry->read_bytes };
+
+	return hash_bytes (key, sizeof key);
+}
+
+static bool text_less (const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED) {
+	const struct text_entry *x = hash_entry (a, struct text_entry, elem);
+	const struct text_entry *y = hash_entry (b, struct text_entry, elem);
+
+	if (x->inode != y->inode)
+		return x->inode < y->inode;
+	if (x->ofs != y->ofs)
+		return x->ofs < y->ofs;
+	return x->read_bytes < y->read_bytes;
 }
 
 /* Initialize new supplemental page table */
 void supplemental_page_table_init (struct supplemental_page_table *spt UNUSED) {
 	hash_init(&spt->hash_table, page_hash, page_less, NULL);
+	spt->vma_root = NULL;
+	list_init (&spt->prefetches);
 }
 
 /* Copy supplemental page table from src to dst */
 bool supplemental_page_table_copy (struct supplemental_page_table *dst, struct supplemental_page_table *src) {
 	struct hash_iterator i;
 
+	if (!vma_copy_all (dst, src))
+		return false;
+
+	/* Only pages the parent already loaded are copied; the rest are
+	 * built from the child's own areas when it touches them. */
 	hash_first (&i, &src->hash_table);
 
 	while (hash_next (&i)) {
@@ -283,12 +1885,16 @@ bool supplemental_page_table_copy (struct supplemental_page_table *dst, struct s
 		enum vm_type type;
 
 		src_page = hash_entry (hash_cur (&i), struct page, hash_elem);
-		type = page_get_type (src_page);
+		type = VM_TYPE (src_page->operations->type);
+
+		/* The child maps the frames of shared areas from the area. */
+		if (src_page->vma != NULL && src_page->vma->shm != NULL)
+			continue;
 
 		switch (type) {
 
 		case VM_UNINIT:
-			if (!copy_uninit_page (dst, src_page))
+			if (src_page->vma == NULL && !copy_uninit_page (dst, src_page))
 				return false;
 			break;
 
@@ -313,92 +1919,125 @@ bool supplemental_page_table_copy (struct supplemental_page_table *dst, struct s
 static bool copy_uninit_page (struct supplemental_page_table *dst, struct page *src_page) {
 	struct uninit_page *uninit = &src_page->uninit;
 	void *aux = uninit->aux;
-	lazy_load_info *dst_info = NULL;
 
-	if (aux != NULL) {
-		lazy_load_info *src_info = aux;
-		dst_info = malloc (sizeof *dst_info);
+	/* The child's page loads through the same segment. */
+	if (uninit->init == lazy_load_segment)
+		segment_get (aux);
+	else if (uninit->init == lazy_load_file) {
+		struct file_page *file_page = slab_alloc (&file_aux_cache);
 
-		if (dst_info == NULL)
+		if (file_page == NULL)
 			return false;
-		
-		memcpy (dst_info, src_info, sizeof *dst_info);
-
-		if (src_info->file != NULL) {
-			dst_info->file = file_reopen (src_info->file);
-			if (dst_info->file == NULL)
-				goto fail;
-		}
-		aux = dst_info;
+		*file_page = *(struct file_page *) aux;
+		aux = file_page;
 	}
 
-	if (!vm_alloc_page_with_initializer (uninit->type, src_page->va, src_page->writable, uninit->init, aux))
-		goto fail;
-
-	return true;
-
-fail:
-	if (dst_info != NULL) {
-		if (dst_info->file != NULL)
-			file_close (dst_info->file);
-		free (dst_info);
+	if (!vm_alloc_page_with_initializer (uninit->type, src_page->va, src_page->writable, uninit->init, aux)) {
+		if (uninit->init == lazy_load_segment)
+			segment_put (aux);
+		else
+			slab_free (aux);
+		return false;
 	}
-	return false;
+	return true;
 }
 
 
-static bool copy_anon_page (struct supplemental_page_table *dst, struct page *src_page) {
-	struct page *dst_page;
+/* Adds to DST a copy of SRC_PAGE that shares SRC_FRAME, the pinned
+ * frame backing SRC_PAGE. Both mappings become read-only so that the
+ * first write from either side goes through vm_handle_wp(). */
+static bool copy_shared_page (struct supplemental_page_table *dst, struct page *src_page,
+		struct frame *src_frame) {
+	struct thread *cur = thread_current ();
+	struct page *dst_page = slab_alloc (&page_slab);
 
-	if (!vm_alloc_page (VM_ANON, src_page->va, src_page->writable))
+	if (dst_page == NULL)
 		return false;
 
-	if (src_page->frame == NULL)
-		return true;
+	*dst_page = *src_page;
+	dst_page->owner = cur;
+	dst_page->frame = NULL;
+
+	if (!spt_insert_page (dst, dst_page)) {
+		slab_free (dst_page);
+		return false;
+	}
+	/* A file page writes back through the child's own mapping. */
+	if (VM_TYPE (dst_page->operations->type) == VM_FILE) {
+		dst_page->file.writeback_pending = false;
+		if (dst_page->vma != NULL)
+			dst_page->file.file = dst_page->vma->file;
+	}
 
-	if (!vm_claim_page (src_page->va))
+	lock_acquire (&frame_lock);
+	if (src_frame->huge && !vm_huge_split_locked (src_frame)) {
+		lock_release (&frame_lock);
 		return false;
+	}
+	src_frame->ref_cnt++;
+	rmap_add (src_frame, dst_page);
+	lock_release (&frame_lock);
 
-	dst_page = spt_find_page (dst, src_page->va);
-	memcpy (dst_page->frame->kva, src_page->frame->kva, PGSIZE);
+	if (!pml4_set_page (cur->pml4, dst_page->va, src_frame->kva, false))
+		return false;
+	pml4_set_writable (src_page->owner->pml4, src_page->va, false);
 	return true;
 }
 
-static bool copy_file_page(struct supplemental_page_table *dst_spt, struct page *src_page){
-    void *va = src_page->va;
-    bool writable = src_page->writable;
-    struct file_page *src_fp = &src_page->file;
+/* Adds to DST a copy of SRC_PAGE, a swapped out anonymous page, that
+ * shares its saved contents. */
+static bool copy_swapped_page (struct supplemental_page_table *dst, struct page *src_page) {
+	struct page *dst_page = slab_alloc (&page_slab);
+
+	if (dst_page == NULL)
+		return false;
+
+	*dst_page = *src_page;
+	dst_page->owner = thread_current ();
+	anon_swap_share (src_page, dst_page);
 
-    struct file_page *aux = malloc(sizeof *aux);
-    if (aux == NULL)
-        return false;
+	if (!spt_insert_page (dst, dst_page)) {
+		vm_dealloc_page (dst_page);
+		return false;
+	}
+	return true;
+}
 
-    *aux = *src_fp;   
+static bool copy_anon_page (struct supplemental_page_table *dst, struct page *src_page) {
+	struct frame *src_frame;
+	bool success;
 
-    if (!vm_alloc_page_with_initializer(VM_FILE, va, writable, lazy_load_file, aux)) {
-        free(aux);
-        return false;
-    }
+	src_frame = vm_pin_page (src_page, false);
+	if (src_frame == NULL)
+		return copy_swapped_page (dst, src_page);
 
-    struct page *child_page = spt_find_page(dst_spt, va);
-    if (child_page == NULL)
-        return false;   
+	success = copy_shared_page (dst, src_page, src_frame);
+	vm_unpin_frame (src_frame);
+	return success;
+}
 
-    if (src_page->frame != NULL) {
-        if (!vm_claim_page(va))
-            return false;
+static bool copy_file_page(struct supplemental_page_table *dst_spt, struct page *src_page){
+    struct frame *src_frame;
+    bool success;
 
-        memcpy(child_page->frame->kva, src_page->frame->kva, PGSIZE);
-    }
+    /* A non-resident file page is reloaded from the child's area. */
+    src_frame = vm_pin_page (src_page, false);
+    if (src_frame == NULL)
+        return true;
 
-    return true;
+    success = copy_shared_page (dst_spt, src_page, src_frame);
+    vm_unpin_frame (src_frame);
+    return success;
 }
 
 void supplemental_page_table_kill (struct supplemental_page_table *spt UNUSED) {
 	if (spt == NULL)
 		return;
 
+	/* Write back mapped files in large runs before the pages go. */
+	vma_sync_all (spt);
 	hash_destroy (&spt->hash_table, spt_destroy_page);
+	vma_destroy_all (spt);
 }
 
 static void spt_destroy_page (struct hash_elem *elem, void *aux UNUSED) {
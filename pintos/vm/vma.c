@@ -0,0 +1,578 @@
+/* vma.c: Virtual memory areas, the region-level view of an address
+ * space. An area only describes how its pages are to be built; the
+ * struct page of a given address is created on its first fault. */
+
+#include "vm/vma.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "filesys/file.h"
+#include "userprog/process.h"
+#include "userprog/syscall.h"
+#include "vm/file.h"
+
+/* Pages of all shared anonymous areas, see struct shmem. */
+static size_t shm_page_cnt;
+
+static void vma_free (struct vma *vma);
+static void shm_put (struct shmem *shm);
+static struct segment *segment_create (struct vma *vma);
+static struct vma *tree_insert (struct vma *root, struct vma *vma);
+static struct vma *tree_remove (struct vma *root, struct vma *vma);
+
+/* Adds to SPT an area covering the pages [START, END). Its pages are
+ * of TYPE and take their first READ_BYTES bytes from FILE at OFS, the
+ * rest being zero. Returns NULL if the range overlaps an existing area
+ * or memory runs out. On success the area owns FILE. */
+struct vma *
+vma_create (struct supplemental_page_table *spt, void *start, void *end,
+		enum vm_type type, bool writable, struct file *file, off_t ofs,
+		size_t read_bytes) {
+	struct vma *vma;
+
+	ASSERT (pg_ofs (start) == 0 && pg_ofs (end) == 0);
+
+	if (start >= end || vma_overlaps (spt, start, end))
+		return NULL;
+
+	vma = malloc (sizeof *vma);
+	if (vma == NULL)
+		return NULL;
+
+	vma->start = start;
+	vma->end = end;
+	vma->type = type;
+	vma->writable = writable;
+	vma->file = file;
+	vma->ofs = ofs;
+	vma->read_bytes = read_bytes;
+	vma->advice = VMA_NORMAL;
+	vma->mapped = false;
+	vma->shm = NULL;
+	vma->seg = NULL;
+	list_init (&vma->pages);
+	vma->left = vma->right = NULL;
+	vma->height = 1;
+
+	spt->vma_root = tree_insert (spt->vma_root, vma);
+	return vma;
+}
+
+/* Returns the area of SPT containing VA, or NULL. */
+struct vma *
+vma_find (struct supplemental_page_table *spt, const void *va) {
+	struct vma *vma = spt->vma_root;
+
+	while (vma != NULL) {
+		if (va < vma->start)
+			vma = vma->left;
+		else if (va >= vma->end)
+			vma = vma->right;
+		else
+			return vma;
+	}
+	return NULL;
+}
+
+/* Returns true if any area of SPT intersects [START, END). */
+bool
+vma_overlaps (struct supplemental_page_table *spt, const void *start,
+		const void *end) {
+	struct vma *vma = spt->vma_root;
+
+	while (vma != NULL) {
+		if (end <= vma->start)
+			vma = vma->left;
+		else if (start >= vma->end)
+			vma = vma->right;
+		else
+			return true;
+	}
+	return false;
+}
+
+/* Returns true if every page of [START, END) lies in some area of SPT. */
+bool
+vma_covers (struct supplemental_page_table *spt, const void *start,
+		const void *end) {
+	while (start < end) {
+		struct vma *vma = vma_find (spt, start);
+
+		if (vma == NULL)
+			return false;
+		start = vma->end;
+	}
+	return true;
+}
+
+static void
+advise_tree (struct vma *vma, const void *start, const void *end,
+		enum vma_advice advice) {
+	if (vma == NULL)
+		return;
+	if (start < vma->start)
+		advise_tree (vma->left, start, end, advice);
+	if (end > vma->end)
+		advise_tree (vma->right, start, end, advice);
+	if (start < vma->end && end > vma->start)
+		vma->advice = advice;
+}
+
+/* Sets ADVICE on every area of SPT that intersects [START, END).
+ * Areas are not split, so the advice covers them as a whole. */
+void
+vma_advise (struct supplemental_page_table *spt, const void *start,
+		const void *end, enum vma_advice advice) {
+	advise_tree (spt->vma_root, start, end, advice);
+}
+
+/* Grows VMA downwards so that it starts at START, the way the stack
+ * grows. Fails if another area is in the way. */
+bool
+vma_extend_down (struct supplemental_page_table *spt, struct vma *vma,
+		void *start) {
+	ASSERT (pg_ofs (start) == 0);
+
+	if (start >= vma->start)
+		return true;
+	if (vma_overlaps (spt, start, vma->start))
+		return false;
+
+	/* Nothing lies in between, so VMA keeps its place in the tree. */
+	vma->start = start;
+	return true;
+}
+
+/* Reserves PAGE_CNT pages for a shared area. Fails if that would
+ * take shared areas over half of the user pool. */
+static bool
+shm_reserve (size_t page_cnt) {
+	void *pool_base;
+	size_t pool_cnt;
+	enum intr_level old_level;
+	bool success;
+
+	palloc_user_pool_range (&pool_base, &pool_cnt);
+	old_level = intr_disable ();
+	success = page_cnt <= pool_cnt / 2 - shm_page_cnt;
+	if (success)
+		shm_page_cnt += page_cnt;
+	intr_set_level (old_level);
+	return success;
+}
+
+/* Undoes shm_reserve(). */
+static void
+shm_unreserve (size_t page_cnt) {
+	enum intr_level old_level = intr_disable ();
+
+	shm_page_cnt -= page_cnt;
+	intr_set_level (old_level);
+}
+
+/* Makes the pages of anonymous area VMA shared with the children it
+ * is copied to on fork. Fails if memory runs out, or if shared areas
+ * would take up more than half of the user pool. */
+bool
+vma_share (struct vma *vma) {
+	size_t page_cnt = ((uint8_t *) vma->end - (uint8_t *) vma->start) / PGSIZE;
+	struct shmem *shm;
+
+	ASSERT (VM_TYPE (vma->type) == VM_ANON && vma->file == NULL);
+
+	if (!shm_reserve (page_cnt))
+		return false;
+	shm = calloc (1, sizeof *shm + page_cnt * sizeof *shm->frames);
+	if (shm == NULL) {
+		shm_unreserve (page_cnt);
+		return false;
+	}
+	lock_init (&shm->lock);
+	shm->ref_cnt = 1;
+	shm->page_cnt = page_cnt;
+	vma->shm = shm;
+	return true;
+}
+
+/* Initializer of the pages of shared areas. Never run: such pages are
+ * claimed by mapping the frame their area holds. */
+bool
+vma_shared_init (struct page *page UNUSED, void *aux UNUSED) {
+	NOT_REACHED ();
+}
+
+/* Creates the not yet loaded page of VMA at VA in the current address
+ * space. Returns the new page, or NULL on failure. */
+struct page *
+vma_materialize (struct vma *vma, void *va) {
+	struct thread *t = thread_current ();
+	size_t offset = (uint8_t *) va - (uint8_t *) vma->start;
+	size_t read_bytes = 0;
+	enum vm_type type = vma->type;
+	vm_initializer *init = NULL;
+	void *aux = NULL;
+
+	ASSERT (pg_ofs (va) == 0);
+	ASSERT (va >= vma->start && va < vma->end);
+
+	if (vma->read_bytes > offset)
+		read_bytes = vma->read_bytes - offset < PGSIZE
+			? vma->read_bytes - offset : PGSIZE;
+
+	if (VM_TYPE (vma->type) == VM_FILE) {
+		struct file_page *file_page = slab_alloc (&file_aux_cache);
+
+		if (file_page == NULL)
+			return NULL;
+		file_page->file = vma->file;
+		file_page->ofs = vma->ofs + offset;
+		file_page->read_bytes = read_bytes;
+		file_page->zero_bytes = PGSIZE - read_bytes;
+		file_page->writeback_pending = false;
+		init = lazy_load_file;
+		aux = file_page;
+	} else if (vma->shm != NULL) {
+		init = vma_shared_init;
+	} else if (read_bytes > 0) {
+		if (vma->seg == NULL && (vma->seg = segment_create (vma)) == NULL)
+			return NULL;
+		init = lazy_load_segment;
+		aux = segment_get (vma->seg);
+	} else {
+		/* Pure zero fill, such as bss: never touches the file, and
+		 * never shares a frame through the text cache. */
+		type &= ~VM_TEXT;
+	}
+
+	if (!vm_alloc_page_with_initializer (type, va, vma->writable, init, aux)) {
+		if (init == lazy_load_segment)
+			segment_put (aux);
+		else
+			slab_free (aux);
+		return NULL;
+	}
+	return spt_find_page (&t->spt, va);
+}
+
+/* Turns PAGE, a page of read-only segment area VMA whose contents
+ * eviction dropped, back into the page vma_materialize() creates. Its
+ * claim then reloads it, or maps the frame the text cache holds for
+ * it. */
+void
+vma_unload (struct vma *vma, struct page *page) {
+	size_t offset = (uint8_t *) page->va - (uint8_t *) vma->start;
+	enum vm_type type = vma->type;
+	vm_initializer *init = NULL;
+	void *aux = NULL;
+
+	ASSERT (VM_TYPE (vma->type) == VM_ANON && !vma->writable);
+
+	if (vma->read_bytes > offset) {
+		init = lazy_load_segment;
+		aux = segment_get (vma->seg);
+	} else
+		type &= ~VM_TEXT;
+	uninit_reset (page, init, type, aux, anon_initializer);
+}
+
+/* Removes VMA from SPT and releases it, destroying its pages first so
+ * that dirty file pages are written back. */
+void
+vma_destroy (struct supplemental_page_table *spt, struct vma *vma) {
+	if (VM_TYPE (vma->type) == VM_FILE)
+		do_msync_area (vma);
+
+	while (!list_empty (&vma->pages)) {
+		struct page *page = list_entry (list_front (&vma->pages),
+				struct page, vma_elem);
+
+		spt_remove_page (spt, page);
+	}
+
+	spt->vma_root = tree_remove (spt->vma_root, vma);
+	vma_free (vma);
+}
+
+/* Duplicates the areas rooted at VMA into DST, each with a file of
+ * its own. */
+static bool
+copy_tree (struct supplemental_page_table *dst, const struct vma *vma) {
+	struct file *file = NULL;
+	struct vma *copy;
+
+	if (vma == NULL)
+		return true;
+
+	if (vma->file != NULL && (file = file_reopen (vma->file)) == NULL)
+		return false;
+
+	copy = vma_create (dst, vma->start, vma->end, vma->type, vma->writable,
+			file, vma->ofs, vma->read_bytes);
+	if (copy == NULL) {
+		file_close (file);
+		return false;
+	}
+	copy->advice = vma->advice;
+	copy->mapped = vma->mapped;
+	if (vma->shm != NULL) {
+		lock_acquire (&vma->shm->lock);
+		vma->shm->ref_cnt++;
+		lock_release (&vma->shm->lock);
+		copy->shm = vma->shm;
+	}
+	if (vma->seg != NULL)
+		copy->seg = segment_get (vma->seg);
+	return copy_tree (dst, vma->left) && copy_tree (dst, vma->right);
+}
+
+/* Copies every area of SRC into DST. Pages are not copied. */
+bool
+vma_copy_all (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src) {
+	bool held = lock_held_by_current_thread (&file_lock);
+	bool success;
+
+	if (!held)
+		lock_acquire (&file_lock);
+	success = copy_tree (dst, src->vma_root);
+	if (!held)
+		lock_release (&file_lock);
+	return success;
+}
+
+static void
+sync_tree (struct vma *vma) {
+	if (vma == NULL)
+		return;
+	sync_tree (vma->left);
+	if (VM_TYPE (vma->type) == VM_FILE)
+		do_msync_area (vma);
+	sync_tree (vma->right);
+}
+
+/* Writes back the dirty pages of every file mapping in SPT, which
+ * must be the current address space. */
+void
+vma_sync_all (struct supplemental_page_table *spt) {
+	sync_tree (spt->vma_root);
+}
+
+static void
+destroy_tree (struct vma *vma) {
+	if (vma == NULL)
+		return;
+	destroy_tree (vma->left);
+	destroy_tree (vma->right);
+	vma_free (vma);
+}
+
+/* Releases every area of SPT. Their pages must already be gone. */
+void
+vma_destroy_all (struct supplemental_page_table *spt) {
+	destroy_tree (spt->vma_root);
+	spt->vma_root = NULL;
+}
+
+static void
+vma_free (struct vma *vma) {
+	if (vma->file != NULL) {
+		bool held = lock_held_by_current_thread (&file_lock);
+
+		if (!held)
+			lock_acquire (&file_lock);
+		file_close (vma->file);
+		if (!held)
+			lock_release (&file_lock);
+	}
+	if (vma->shm != NULL)
+		shm_put (vma->shm);
+	if (vma->seg != NULL)
+		segment_put (vma->seg);
+	free (vma);
+}
+
+/* Drops a reference to SHM, releasing its frames with the last one. */
+static void
+shm_put (struct shmem *shm) {
+	bool last;
+
+	lock_acquire (&shm->lock);
+	last = --shm->ref_cnt == 0;
+	lock_release (&shm->lock);
+	if (!last)
+		return;
+
+	for (size_t i = 0; i < shm->page_cnt; i++)
+		if (shm->frames[i] != NULL)
+			vm_frame_put (shm->frames[i]);
+	shm_unreserve (shm->page_cnt);
+	free (shm);
+}
+
+/* Creates the segment that loads the pages of VMA, with a file of its
+ * own so that it can outlive VMA. */
+static struct segment *
+segment_create (struct vma *vma) {
+	struct segment *seg = slab_alloc (&segment_cache);
+
+	if (seg == NULL)
+		return NULL;
+	seg->file = file_reopen (vma->file);
+	if (seg->file == NULL) {
+		slab_free (seg);
+		return NULL;
+	}
+	seg->ofs = vma->ofs;
+	seg->start = vma->start;
+	seg->read_bytes = vma->read_bytes;
+	lock_init (&seg->lock);
+	seg->ref_cnt = 1;
+	return seg;
+}
+
+/* Takes a reference to SEG and returns it. */
+struct segment *
+segment_get (struct segment *seg) {
+	lock_acquire (&seg->lock);
+	seg->ref_cnt++;
+	lock_release (&seg->lock);
+	return seg;
+}
+
+/* Drops a reference to SEG, releasing it with the last one. */
+void
+segment_put (struct segment *seg) {
+	bool last, held;
+
+	lock_acquire (&seg->lock);
+	last = --seg->ref_cnt == 0;
+	lock_release (&seg->lock);
+	if (!last)
+		return;
+
+	held = lock_held_by_current_thread (&file_lock);
+	if (!held)
+		lock_acquire (&file_lock);
+	file_close (seg->file);
+	if (!held)
+		lock_release (&file_lock);
+	slab_free (seg);
+}
+
+/* Stores where the contents of the page of SEG at VA come from. */
+void
+segment_locate (const struct segment *seg, const void *va, off_t *ofs,
+		size_t *read_bytes) {
+	size_t offset = (const uint8_t *) va - (const uint8_t *) seg->start;
+
+	*ofs = seg->ofs + offset;
+	*read_bytes = 0;
+	if (seg->read_bytes > offset)
+		*read_bytes = seg->read_bytes - offset < PGSIZE
+			? seg->read_bytes - offset : PGSIZE;
+}
+
+/* AVL tree of areas, ordered by start address. */
+
+static int
+tree_height (const struct vma *vma) {
+	return vma != NULL ? vma->height : 0;
+}
+
+static void
+tree_update (struct vma *vma) {
+	int left = tree_height (vma->left);
+	int right = tree_height (vma->right);
+
+	vma->height = (left > right ? left : right) + 1;
+}
+
+static struct vma *
+rotate_right (struct vma *vma) {
+	struct vma *left = vma->left;
+
+	vma->left = left->right;
+	left->right = vma;
+	tree_update (vma);
+	tree_update (left);
+	return left;
+}
+
+static struct vma *
+rotate_left (struct vma *vma) {
+	struct vma *right = vma->right;
+
+	vma->right = right->left;
+	right->left = vma;
+	tree_update (vma);
+	tree_update (right);
+	return right;
+}
+
+/* Restores the balance of the subtree rooted at VMA after one of its
+ * children changed height by one. Returns the new subtree root. */
+static struct vma *
+tree_rebalance (struct vma *vma) {
+	int balance;
+
+	tree_update (vma);
+	balance = tree_height (vma->left) - tree_height (vma->right);
+
+	if (balance > 1) {
+		if (tree_height (vma->left->left) < tree_height (vma->left->right))
+			vma->left = rotate_left (vma->left);
+		return rotate_right (vma);
+	}
+	if (balance < -1) {
+		if (tree_height (vma->right->right) < tree_height (vma->right->left))
+			vma->right = rotate_right (vma->right);
+		return rotate_left (vma);
+	}
+	return vma;
+}
+
+static struct vma *
+tree_insert (struct vma *root, struct vma *vma) {
+	if (root == NULL)
+		return vma;
+
+	if (vma->start < root->start)
+		root->left = tree_insert (root->left, vma);
+	else
+		root->right = tree_insert (root->right, vma);
+	return tree_rebalance (root);
+}
+
+/* Unlinks the leftmost area under ROOT and stores it in *MIN. */
+static struct vma *
+tree_remove_min (struct vma *root, struct vma **min) {
+	if (root->left == NULL) {
+		*min = root;
+		return root->right;
+	}
+	root->left = tree_remove_min (root->left, min);
+	return tree_rebalance (root);
+}
+
+static struct vma *
+tree_remove (struct vma *root, struct vma *vma) {
+	ASSERT (root != NULL);
+
+	if (vma->start < root->start)
+		root->left = tree_remove (root->left, vma);
+	else if (vma->start > root->start)
+		root->right = tree_remove (root->right, vma);
+	else {
+		struct vma *min;
+
+		if (root->right == NULL)
+			return root->left;
+		root->right = tree_remove_min (root->right, &min);
+		min->left = root->left;
+		min->right = root->right;
+		root = min;
+	}
+	return tree_rebalance (root);
+}